@@ -0,0 +1,21 @@
+#ifndef __ALLOC_COUNTER_H__
+#define __ALLOC_COUNTER_H__
+
+#include <Arduino.h>
+
+/**
+ * @brief Starts counting the heap allocations of the task.
+ *
+ * Only one task is watched at a time. The allocations are counted by the
+ * heap hook of ESP-IDF, so Strings and containers are both included. It is
+ * only built in the lilygo-t-display-s3-alloc environment, which defines
+ * ALLOC_COUNTER and enables CONFIG_HEAP_USE_HOOKS, and reports 0 otherwise.
+ */
+void alloc_counter_watch(TaskHandle_t task);
+
+/**
+ * @brief Allocations of the watched task since it is watched.
+ */
+uint32_t alloc_counter_get();
+
+#endif//__ALLOC_COUNTER_H__
@@ -17,8 +17,13 @@
 #define PREF_ECO_MODE ("ECO_MODE")
 #define PREF_ECO_STATE ("ECO_STATE")
 #define PREF_BRIGHTNESS ("BRIGHTNESS")
+#define PREF_DISPLAY_MODE ("DISPLAY_MODE")
 
 #define NS_SETTINGS ("Settings")
+// Station metadata of the OEBB API, one entry per EVA
+#define NS_STATIONS ("Stations")
+#define STATION_CACHE_VERSION (1)
+#define STATION_CACHE_TTL (7 * 86400)
 
 #define NUMBER_COUNTDOWNS (2)
 #define SOFT_RESET_TIME (5000)
@@ -27,7 +32,19 @@
 #define REBOOT_INTERVAL_MS (86400000ULL)
 #define BUTTON_DELAY (100)
 #define DATA_UPDATE_DELAY (20000)
+#define DATA_COALESCE_WINDOW (200) // Notifications within this window are merged once
+#define POLL_DELAY_FAST (10000)
+#define POLL_DELAY_SLOW (60000)
+#define POLL_DELAY_IDLE (300000)
+#define POLL_DELAY_MAX_BACKOFF (300000)
+#define POLL_DELAY_WAKE (2000) // After WiFi returned or the RBLs changed
+#define POLL_IMMINENT_COUNTDOWN (2)
+#define POLL_DISTANT_COUNTDOWN (15)
+#define POLL_IDLE_COUNTDOWN (60)
 #define SCREEN_UPDATE_DELAY (10)
+#define NEXT_DEPARTURES_COUNT (12) // Length of the merged list of the next departures mode
+#define RENDER_STATS_FRAMES (6000) // Frames between two logs of the render stats
+#define MIN_VALID_EPOCH (1704067200) // 2024-01-01, older means the clock is not synchronised
 #define ADDITIONAL_COUNTDOWN_DELAY (50)
 #define INSTRUCTION_FONT_SIZE (4)
 #define SCROLLRATE (2)
@@ -46,6 +63,17 @@ enum EcoModeState {
    ECO_AUTOMATIC_ON, // Eco mode was automatically turned on
 };
 
+enum DisplayMode {
+   DISPLAY_MONITORS = 0,   // One row per line and stop
+   DISPLAY_NEXT_DEPARTURES // One row per departure, the soonest of all monitors first
+};
+
+struct StationInfo {
+    String name;
+    String plc;
+    time_t updated; // Epoch of the last refresh, 0 if the clock was not synchronised
+};
+
 class Configuration {
     private:
         Preferences db;
@@ -60,9 +88,14 @@ class Configuration {
         EcoMode ram_eco_mode;
         EcoModeState ram_eco_state;
         double ram_brightness;
+        DisplayMode ram_display_mode;
 
         static int32_t verify_number_lines(int32_t count);
 
+        static DisplayMode verify_display_mode(int32_t value);
+
+        static String station_key(const String& eva);
+
         explicit Configuration();
     public:
         static Configuration& getInstance();
@@ -103,6 +136,16 @@ class Configuration {
 
         void set_brightness(double value);
         double get_brightness();
+
+        void set_display_mode(int32_t value);
+        DisplayMode get_display_mode();
+
+        /**
+         * @brief Reads the cached metadata of a station, regardless of its age.
+         * @return False if there is no entry of the current version.
+         */
+        bool get_station(const String& eva, StationInfo& info);
+        void set_station(const String& eva, const StationInfo& info);
 };
 
 #endif // __CFG_H__
\ No newline at end of file
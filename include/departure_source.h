@@ -0,0 +1,124 @@
+#ifndef __DEPARTURE_SOURCE_H__
+#define __DEPARTURE_SOURCE_H__
+
+#include <Arduino.h>
+#include <memory>
+#include <vector>
+
+#include "line_filter.h"
+#include "traffic.h"
+
+// Vectors kept for reuse, a reader holding an older snapshot blocks only its own buffer
+#define DEPARTURE_SOURCE_BUFFERS (3)
+
+struct SnapshotStats {
+    uint32_t published = 0;
+    uint32_t buffer_reuses = 0;
+    uint32_t buffer_allocations = 0;  // No buffer was free, a new vector was allocated
+};
+
+/**
+ * @brief Sorts the vehicles by their countdown.
+ */
+void sort_vehicles(std::vector<Vehicle>& vehicles);
+
+/**
+ * @brief Adds the monitor to the index, or appends its vehicles to the monitor of the same line and stop.
+ */
+void merge_monitor(MonitorIndex& index, const Monitor& monitor);
+
+void merge_monitor(MonitorIndex& index, Monitor&& monitor);
+
+/**
+ * @brief Publishing side shared by all departure sources.
+ *
+ * A source only implements its transport and the mapping of the response
+ * fields to monitors. It builds the monitors in a buffer taken from
+ * acquire_buffer() on its own task and hands it to publish(), which
+ * replaces the snapshot and notifies the data coordinator. Published
+ * snapshots are never modified, readers share them without a copy.
+ */
+class DepartureSource {
+    private:
+        const char* name;
+        TaskHandle_t notification;
+        MonitorSnapshot snapshot;
+        uint32_t snapshot_version;
+        std::shared_ptr<std::vector<Monitor>> buffers[DEPARTURE_SOURCE_BUFFERS];
+        ContentHashStats hash_stats;
+        SnapshotStats snapshot_stats;
+
+    protected:
+        SemaphoreHandle_t internal_mutex;
+        LineFilter line_filter;
+
+        explicit DepartureSource(const char* name);
+
+        /**
+         * @brief Calls the callback with every trimmed, non-empty entry of a comma-separated list.
+         */
+        template<typename Callback>
+        static void for_each_entry(const String& list, Callback callback) {
+            int pos = 0;
+            while (pos < (int)list.length()) {
+                int end = list.indexOf(',', pos);
+                if (end == -1) {
+                    end = list.length();
+                }
+                String entry = list.substring(pos, end);
+                pos = end + 1;
+                entry.trim();
+                if (entry.length()) {
+                    callback(entry);
+                }
+            }
+        }
+
+        /**
+         * @brief Restarts to reset the heap if the connection was refused.
+         *
+         * Heap fragmentation makes the TLS handshake fail, because it needs a
+         * lot of contiguous RAM. The original software rebooted periodically.
+         */
+        static void restart_if_refused(int http_code);
+
+        /**
+         * @brief Compares the hash of a response with the published one and counts the result.
+         * @return True if the hash changed, it is stored as the published hash.
+         */
+        bool is_content_changed(uint32_t& published_hash, uint32_t hash);
+
+        /**
+         * @brief Returns an empty vector that is not shared with any reader.
+         *
+         * The mutex must not be held.
+         */
+        std::shared_ptr<std::vector<Monitor>> acquire_buffer();
+
+        /**
+         * @brief Replaces the snapshot with the buffer and notifies the data coordinator.
+         *
+         * The mutex must not be held, the buffer must not be modified afterwards.
+         */
+        void publish(const std::shared_ptr<std::vector<Monitor>>& monitors);
+
+    public:
+        DepartureSource(const DepartureSource&) = delete;
+        DepartureSource& operator=(const DepartureSource&) = delete;
+
+        void set_notification(TaskHandle_t task);
+
+        /**
+         * @brief Shares the latest published monitors without copying them.
+         */
+        void get_latest_snapshot(SourceSnapshot& data);
+
+        /**
+         * @brief Updates that were not published because no departure changed.
+         */
+        ContentHashStats get_content_hash_stats();
+
+        SnapshotStats get_snapshot_stats();
+};
+
+#endif//__DEPARTURE_SOURCE_H__
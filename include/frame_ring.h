@@ -0,0 +1,80 @@
+#ifndef __FRAME_RING_H__
+#define __FRAME_RING_H__
+
+#include <Arduino.h>
+#include <atomic>
+
+struct FrameRingStats {
+    uint32_t pushed = 0;
+    uint32_t popped = 0;
+    uint32_t overruns = 0;   // Ring was full, the frame was discarded
+    uint32_t oversized = 0;  // Frame did not fit into a slot
+    size_t max_frame_size = 0;
+};
+
+struct FrameRingSlot {
+    size_t length;
+    uint8_t tag;
+};
+
+/**
+ * @brief Single-producer/single-consumer queue of frames, stored in PSRAM.
+ *
+ * The ring has a fixed number of slots, each holding one zero-terminated
+ * frame and a tag naming its origin. The producer copies a frame into the
+ * next free slot, the consumer reads the oldest slot in place and releases
+ * it with pop(). Neither side blocks or takes a lock.
+ */
+class FrameRing {
+    private:
+        const char* name;
+        uint8_t* buffer;
+        size_t slot_size;
+        size_t slot_count;
+        FrameRingSlot* slots;
+        std::atomic<uint32_t> head;  // Written by the producer only
+        std::atomic<uint32_t> tail;  // Written by the consumer only
+        // Read by get_stats() from any task
+        std::atomic<uint32_t> pushed;
+        std::atomic<uint32_t> popped;
+        std::atomic<uint32_t> overruns;
+        std::atomic<uint32_t> oversized;
+        std::atomic<size_t> max_frame_size;
+
+        uint8_t* slot(uint32_t index) const;
+
+    public:
+        explicit FrameRing(const char* name, size_t slot_size, size_t slot_count);
+
+        ~FrameRing();
+
+        FrameRing(const FrameRing&) = delete;
+        FrameRing& operator=(const FrameRing&) = delete;
+
+        /**
+         * @brief Allocates the slots, must be called before the producer starts.
+         */
+        bool begin();
+
+        /**
+         * @brief Copies the frame into the ring (producer side).
+         * @return False if the frame was dropped.
+         */
+        bool push(const uint8_t* data, size_t length, uint8_t tag = 0);
+
+        /**
+         * @brief Returns the oldest frame or nullptr if the ring is empty (consumer side).
+         *
+         * The frame stays valid and may be modified until pop() is called.
+         */
+        char* front(size_t& length, uint8_t& tag);
+
+        void pop();
+
+        /**
+         * @brief Returns a snapshot of the counters, each one is read atomically.
+         */
+        FrameRingStats get_stats() const;
+};
+
+#endif//__FRAME_RING_H__
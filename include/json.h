@@ -4,7 +4,7 @@
 #include <time.h>
 #include <ArduinoJson.h> // by Benoit Blanchon
 
-time_t timegm(struct tm *const t);
+#include "timestamp.h"
 
 namespace ArduinoJson {
     template <>
@@ -13,19 +13,7 @@ namespace ArduinoJson {
         static time_t fromJson(JsonVariantConst variant) {
             const char* s = variant.as<const char*>();
             if (!s) return 0;
-
-            struct tm t = {0};
-            // Fast parsing for ISO8601 (YYYY-MM-DDTHH:MM:SSZ)
-            if (sscanf(s, "%d-%d-%dT%d:%d:%dZ", 
-                       &t.tm_year, &t.tm_mon, &t.tm_mday, 
-                       &t.tm_hour, &t.tm_min, &t.tm_sec) != 6) {
-                return 0;
-            }
-
-            t.tm_year -= 1900; // Year since 1900
-            t.tm_mon -= 1;     // Month 0-11
-            t.tm_isdst = 0;
-            return timegm(&t);
+            return parse_timestamp(s);
         }
 
         // This would be used if you were creating JSON from time_t
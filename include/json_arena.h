@@ -0,0 +1,61 @@
+#ifndef __JSON_ARENA_H__
+#define __JSON_ARENA_H__
+
+#include <Arduino.h>
+#include <ArduinoJson.h> // by Benoit Blanchon
+
+/**
+ * @brief Bump allocator for ArduinoJson documents backed by a buffer in PSRAM.
+ *
+ * Deallocation is a no-op, the whole arena is released with reset() once all
+ * documents using it are destroyed. Parsing therefore never fragments the
+ * internal heap, which is needed for the TLS handshakes.
+ */
+class JsonArena : public ArduinoJson::Allocator {
+    private:
+        const char* name;
+        uint8_t* buffer;
+        size_t capacity;
+        size_t used;
+        size_t last_offset;
+        size_t high_water_mark;
+        size_t reported_high_water_mark;
+        uint32_t failed_allocations;
+
+        bool ensure_buffer();
+
+        static size_t block_size(const void* ptr);
+
+    public:
+        explicit JsonArena(const char* name, size_t capacity);
+
+        ~JsonArena();
+
+        // The arena is shared by reference with the documents
+        JsonArena(const JsonArena&) = delete;
+        JsonArena& operator=(const JsonArena&) = delete;
+
+        void* allocate(size_t size) override;
+
+        void deallocate(void* ptr) override;
+
+        void* reallocate(void* ptr, size_t new_size) override;
+
+        /**
+         * @brief Releases all allocations, no document may use the arena anymore.
+         */
+        void reset();
+
+        size_t get_capacity() const;
+
+        size_t get_high_water_mark() const;
+
+        uint32_t get_failed_allocations() const;
+
+        /**
+         * @brief Prints the usage of the arena if a new high water mark was reached.
+         */
+        void print_high_water_mark();
+};
+
+#endif//__JSON_ARENA_H__
@@ -0,0 +1,189 @@
+#ifndef __JSON_STREAM_H__
+#define __JSON_STREAM_H__
+
+#include <initializer_list>
+#include <Arduino.h>
+
+#define JSON_STREAM_MAX_DEPTH (16)
+#define JSON_STREAM_MAX_STRING (512)
+#define JSON_STREAM_MAX_LITERAL (32)
+
+// Reserved key ids, handlers map their own keys to ids in between
+#define JSON_KEY_UNKNOWN (0)
+#define JSON_KEY_ITEM (0xFF)
+
+enum JsonStreamValue {
+    JSON_STREAM_STRING = 0,
+    JSON_STREAM_NUMBER,
+    JSON_STREAM_TRUE,
+    JSON_STREAM_FALSE,
+    JSON_STREAM_NULL
+};
+
+/**
+ * @brief Position of the current element inside the document.
+ *
+ * Every level holds the id of the object key the element is stored under,
+ * or JSON_KEY_ITEM if it is an element of an array.
+ * E.g. data.monitors[3].lines -> {DATA, MONITORS, JSON_KEY_ITEM, LINES}
+ */
+class JsonStreamPath {
+    private:
+        const uint8_t* keys;
+        size_t depth;
+
+    public:
+        JsonStreamPath(const uint8_t* keys, size_t depth) : keys(keys), depth(depth) {}
+
+        size_t size() const {
+            return depth;
+        }
+
+        uint8_t operator[](size_t idx) const {
+            return keys[idx];
+        }
+
+        uint8_t back() const {
+            return depth ? keys[depth - 1] : JSON_KEY_UNKNOWN;
+        }
+
+        bool matches(std::initializer_list<uint8_t> expected) const {
+            if (expected.size() != depth) return false;
+            size_t i = 0;
+            for (uint8_t key : expected) {
+                if (keys[i++] != key) return false;
+            }
+            return true;
+        }
+
+        bool ends_with(std::initializer_list<uint8_t> expected) const {
+            if (expected.size() > depth) return false;
+            size_t i = depth - expected.size();
+            for (uint8_t key : expected) {
+                if (keys[i++] != key) return false;
+            }
+            return true;
+        }
+};
+
+/**
+ * @brief Receives the events of the JsonStreamParser.
+ *
+ * Strings passed to the handler are only valid during the call.
+ */
+class JsonStreamHandler {
+    public:
+        virtual ~JsonStreamHandler() {}
+
+        /**
+         * @brief Maps an object key to an id, unknown keys should return JSON_KEY_UNKNOWN.
+         */
+        virtual uint8_t map_key(const char* key, size_t length) = 0;
+
+        virtual void on_begin(const JsonStreamPath& path, bool is_array) {}
+
+        virtual void on_end(const JsonStreamPath& path, bool is_array) {}
+
+        virtual void on_value(const JsonStreamPath& path, JsonStreamValue type, const char* value, size_t length) {}
+
+        virtual void on_document_end() {}
+};
+
+/**
+ * @brief Resumable JSON tokenizer that is fed with chunks as they arrive.
+ *
+ * Nothing of the document is kept besides the nesting stack and the
+ * currently parsed token, so memory usage is constant regardless of the
+ * payload size. Strings longer than JSON_STREAM_MAX_STRING are truncated.
+ * It is a Stream so it can be passed to HTTPClient::writeToStream, which
+ * takes care of chunked transfer encoding.
+ */
+class JsonStreamParser : public Stream {
+    private:
+        enum State : uint8_t {
+            S_VALUE = 0,
+            S_ARRAY_FIRST,
+            S_OBJECT_FIRST,
+            S_OBJECT_KEY,
+            S_COLON,
+            S_AFTER_VALUE,
+            S_STRING,
+            S_STRING_ESCAPE,
+            S_STRING_UNICODE,
+            S_LITERAL,
+            S_DONE,
+            S_ERROR
+        };
+
+        JsonStreamHandler* handler;
+        State state;
+        bool is_key;
+        bool is_array[JSON_STREAM_MAX_DEPTH];
+        uint8_t keys[JSON_STREAM_MAX_DEPTH];
+        size_t depth;
+        char token[JSON_STREAM_MAX_STRING + 1];
+        size_t token_length;
+        uint32_t unicode;
+        uint8_t unicode_digits;
+        uint16_t high_surrogate;
+        size_t bytes_fed;
+
+        bool process(char c);
+
+        bool begin_container(bool array);
+
+        bool end_container(bool array);
+
+        void end_value();
+
+        void emit_string();
+
+        bool emit_literal();
+
+        void append(char c);
+
+        void append_code_point(uint32_t code_point);
+
+    public:
+        explicit JsonStreamParser();
+
+        /**
+         * @brief Prepares the parser for a new document.
+         *
+         * @param handler Receives the events of the document.
+         */
+        void reset(JsonStreamHandler* handler);
+
+        /**
+         * @brief Feeds the next chunk of the document.
+         *
+         * @return false if the document is malformed.
+         */
+        bool feed(const uint8_t* data, size_t length);
+
+        bool is_done() const;
+
+        bool has_error() const;
+
+        size_t get_bytes_fed() const;
+
+        size_t write(uint8_t c) override;
+
+        size_t write(const uint8_t* buffer, size_t size) override;
+
+        int available() override {
+            return 0;
+        }
+
+        int read() override {
+            return -1;
+        }
+
+        int peek() override {
+            return -1;
+        }
+
+        void flush() override {}
+};
+
+#endif//__JSON_STREAM_H__
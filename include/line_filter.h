@@ -0,0 +1,55 @@
+#ifndef __LINE_FILTER_H__
+#define __LINE_FILTER_H__
+
+#include <Arduino.h>
+#include <vector>
+
+struct LineFilterRule {
+    String line;       // Line name, may contain the wildcards '*' and '?'
+    String direction;  // Prefix of the direction, empty for all directions
+};
+
+/**
+ * @brief Comma-separated line filter, compiled once when the configuration changes.
+ *
+ * Every entry is a line name like "U2", optionally restricted to a direction
+ * with "U2:Seestadt". Line names may contain the wildcards '*' (any number of
+ * characters) and '?' (exactly one character), e.g. "U*" or "S4?".
+ * An empty filter matches all lines.
+ */
+class LineFilter {
+    private:
+        String source;
+        // Plain line names for all directions, sorted for a binary search
+        std::vector<String> lines;
+        // Entries with wildcards or a direction
+        std::vector<LineFilterRule> rules;
+
+        static bool match_pattern(const char* pattern, const char* text);
+
+        static bool match_direction(const String& direction, const char* towards);
+
+        bool has_line(const char* line) const;
+
+    public:
+        /**
+         * @brief Parses the filter, does nothing if it did not change since the last call.
+         * @return True if the filter was recompiled.
+         */
+        bool compile(const String& filter);
+
+        bool is_empty() const;
+
+        const String& get_source() const;
+
+        /**
+         * @brief Checks if any direction of the line can pass the filter.
+         *
+         * Used to reject a line before its departures are built.
+         */
+        bool matches_line(const char* line) const;
+
+        bool matches(const char* line, const char* towards) const;
+};
+
+#endif//__LINE_FILTER_H__
@@ -1,34 +1,281 @@
 #ifndef __OEBB_H__
 #define __OEBB_H__
 
+#include <atomic>
 #include <time.h>
 #include <WiFi.h>
 #include <HTTPClient.h>
 #include <WiFiClientSecure.h>
 #include <WebSocketsClient.h> // Library: WebSockets by Markus Sattler
+#include "config.h"
+#include "departure_source.h"
+#include "frame_ring.h"
 #include "json.h"
+#include "json_arena.h"
+#include "json_stream.h"
 
 #include "traffic.h"
 
 #define URL_OEBB "https://meine.oebb.at/abfahrtankunft/api/evaNrs/"
+#define STATION_REFRESH_RETRY_DELAY (600000)
+#define ARENA_SIZE_OEBB_STATION (8 * 1024)
+// Received frames wait in PSRAM until the parser task picks them up
+#define OEBB_FRAME_SLOT_SIZE (48 * 1024)
+#define OEBB_FRAME_SLOTS (3)
+#define OEBB_ACK_MAX_LENGTH (96)
+#define OEBB_MAX_STATIONS (3)
+// A frame tag holds the station index in the low bits and the generation of the station list in the high bits
+#define OEBB_FRAME_TAG_INDEX_BITS (4)
+// Reconnects back off exponentially with jitter, the circuit breaker pauses them after repeated failures
+#define OEBB_CONNECT_TIMEOUT (10000)
+#define OEBB_BACKOFF_MIN (10000)
+#define OEBB_BACKOFF_MAX (300000)
+#define OEBB_STABLE_CONNECTION (60000)
+#define OEBB_CIRCUIT_BREAKER_FAILURES (6)
+#define OEBB_CIRCUIT_OPEN_DELAY (1800000)
+#define OEBB_ERROR_MAX_LENGTH (64)
+#define OEBB_ID_MAX_LENGTH (32)
+#define OEBB_LINE_MAX_LENGTH (16)
+#define OEBB_TRACK_MAX_LENGTH (16)
+#define OEBB_DESTINATION_MAX_LENGTH (96)
 
-class OEBBDeparture {
+enum OEBBKey : uint8_t {
+    OEBB_KEY_UNKNOWN = JSON_KEY_UNKNOWN,
+    OEBB_KEY_METHOD,
+    OEBB_KEY_ID,
+    OEBB_KEY_PARAMS,
+    OEBB_KEY_DATA,
+    OEBB_KEY_DEPARTURES,
+    OEBB_KEY_LINE,
+    OEBB_KEY_TRACK,
+    OEBB_KEY_SCHEDULED,
+    OEBB_KEY_EXPECTED,
+    OEBB_KEY_DESTINATION,
+    OEBB_KEY_DEFAULT,
+    OEBB_KEY_FLAGS
+};
+
+/**
+ * @brief Builds the monitors of an update frame from the events of the JsonStreamParser.
+ *
+ * The fields of a departure are kept in fixed buffers, Strings are only
+ * created for departures that pass the line filter.
+ */
+class OEBBMonitorParser : public JsonStreamHandler {
     private:
-        WebSocketsClient web_socket;
+        std::vector<Monitor>& monitors;
+        const LineFilter* filter;
+        MonitorIndex monitor_index;
         String station_name;
-        String station_id;
-        SemaphoreHandle_t internal_mutex;
+        time_t now;
+        uint32_t content_hash;
+        bool is_update_method;
+        bool is_id_string;
+        char id[OEBB_ID_MAX_LENGTH];
+        char line[OEBB_LINE_MAX_LENGTH];
+        char track[OEBB_TRACK_MAX_LENGTH];
+        char destination[OEBB_DESTINATION_MAX_LENGTH];
+        time_t scheduled;
+        time_t expected;
+        bool is_cancelled;
+        bool is_airport;
+
+        static void copy_value(char* target, size_t size, const char* value, size_t length);
+
+        static uint32_t hash(uint32_t hash, const char* data, size_t length);
+
+        void merge_departure();
+
+    public:
+        explicit OEBBMonitorParser(std::vector<Monitor>& monitors);
+
+        /**
+         * @brief Clears the output vector and prepares for a new frame.
+         */
+        void begin(const String& station_name, const LineFilter& filter);
+
+        /**
+         * @brief True if the frame is an update that has to be acknowledged.
+         */
+        bool is_update() const;
+
+        /**
+         * @brief Writes the JSON-RPC response by splicing the id into a static template.
+         * @return The length of the response, 0 if it does not fit into the buffer.
+         */
+        size_t format_ack(char* buffer, size_t size) const;
+
+        /**
+         * @brief Hash over the visible fields of all accepted departures, independent of their order.
+         */
+        uint32_t get_content_hash() const;
+
+        uint8_t map_key(const char* key, size_t length) override;
+
+        void on_begin(const JsonStreamPath& path, bool is_array) override;
+
+        void on_end(const JsonStreamPath& path, bool is_array) override;
+
+        void on_value(const JsonStreamPath& path, JsonStreamValue type, const char* value, size_t length) override;
+
+        void on_document_end() override;
+};
+
+enum OEBBConnectionState {
+    OEBB_IDLE = 0,       // Not started, the station is unknown or closed
+    OEBB_CONNECTING,     // Handshake in progress, loop() is called until it succeeds or times out
+    OEBB_CONNECTED,
+    OEBB_BACKOFF,        // Waiting for the next attempt
+    OEBB_CIRCUIT_OPEN    // Too many failures, attempts are paused
+};
+
+struct OEBBConnectionStats {
+    OEBBConnectionState state = OEBB_IDLE;
+    uint32_t connects = 0;
+    uint32_t reconnects = 0;
+    uint32_t failed_attempts = 0;
+    uint32_t consecutive_failures = 0;
+    uint32_t circuit_opens = 0;
+    uint32_t errors = 0;
+    unsigned long last_handshake_ms = 0;
+    unsigned long max_handshake_ms = 0;
+    unsigned long uptime_ms = 0;        // Of all finished connections
+    unsigned long connected_since = 0;  // millis() of the current connection
+    char last_error[OEBB_ERROR_MAX_LENGTH] = "";
+};
+
+/**
+ * @brief Websocket session of one station, all sessions are run by the same task.
+ */
+struct OEBBStation {
+    String eva;
+    String name;
+    String plc;
+    time_t updated;
+    unsigned long refresh_attempt;
+    uint32_t content_hash;  // Of the published monitors, 0 if none were published
+    WebSocketsClient web_socket;
+    OEBBConnectionStats connection_stats;
+    unsigned long attempt_start;
+    unsigned long backoff_start;
+    unsigned long backoff_delay;
+    std::vector<Monitor> monitors;
+    // Handed between the websocket task and the refresh task under the mutex
+    bool is_refresh_requested;
+    bool is_refreshed;
+    StationInfo refreshed_info;
+};
+
+struct OEBBAck {
+    uint8_t station;
+    char text[OEBB_ACK_MAX_LENGTH];
+};
+
+class OEBBDeparture : public DepartureSource {
+    private:
+        OEBBStation stations[OEBB_MAX_STATIONS];
+        size_t station_count;
+        // Changes with every set_stations(), frames queued for the previous stations are dropped
+        std::atomic<uint8_t> station_generation;
         TaskHandle_t handle_task_traffic;
-        TaskHandle_t notification;
-        std::vector<Monitor> monitors;
+        TaskHandle_t handle_task_parse;
+        // Fetches the station metadata, the websocket task must not wait for HTTP requests
+        TaskHandle_t handle_task_refresh;
+        // Acknowledgements are sent by the websocket task, the parser only queues them
+        QueueHandle_t ack_queue;
+        // Frames of all stations, tagged with the index of the station and the station generation
+        FrameRing frame_ring;
+        // Parsed into from the frame, swapped into the monitors of its station afterwards
+        std::vector<Monitor> pending_monitors;
+        JsonStreamParser stream_parser;
+        OEBBMonitorParser monitor_parser;
+        JsonArena station_arena;
         
         static void task_traffic(void *pvParameters);
 
-        void event(WStype_t type, uint8_t * payload, size_t length);
+        static void task_parse(void *pvParameters);
+
+        static void task_refresh(void *pvParameters);
+
+        void event(size_t idx, WStype_t type, uint8_t * payload, size_t length);
+
+        /**
+         * @brief Parses a frame taken from the ring and publishes the monitors of its station.
+         */
+        void process_frame(uint8_t tag, const char* frame, size_t length);
+
+        /**
+         * @brief Returns true if the frame was received for the current stations, the mutex must be held.
+         */
+        bool is_current_frame(uint8_t tag) const;
+
+        void send_acks();
+
+        /**
+         * @brief Splits the comma-separated EVAs into the stations.
+         */
+        void set_stations(const String& eva);
+
+        /**
+         * @brief Joins the monitors of all stations into a new snapshot.
+         */
+        void publish_stations();
+
+        /**
+         * @brief True if no station has a monitor, the mutex must be held.
+         */
+        bool is_empty() const;
         
-        void get_station();
+        /**
+         * @brief Fetches the metadata of the station and stores it in the cache.
+         * @param is_restart_allowed If a refused connection may restart the device.
+         * @return True if the station was received.
+         */
+        bool fetch_station(const String& eva, StationInfo& info, bool is_restart_allowed);
+
+        bool get_station(OEBBStation& station);
+
+        void set_station(OEBBStation& station, const StationInfo& info);
 
-        void fill_monitors_from_json(JsonDocument& root);
+        /**
+         * @brief Takes the station from the cache, only fetches it if it was never cached.
+         */
+        bool load_station(OEBBStation& station);
+
+        bool is_station_refresh_due(const OEBBStation& station);
+
+        /**
+         * @brief Hands the station to the refresh task, the result is applied by refresh_station().
+         */
+        void request_station_refresh(OEBBStation& station);
+
+        /**
+         * @brief Applies a finished refresh and reconnects if the station moved.
+         */
+        void refresh_station(size_t idx);
+
+        void connect_socket(size_t idx);
+
+        /**
+         * @brief Advances the connection state machine of a disconnected station.
+         * @return True if loop() may be called to (continue to) connect.
+         */
+        bool is_connect_due(OEBBStation& station);
+
+        void on_connected(OEBBStation& station);
+
+        void on_disconnected(OEBBStation& station, const char* reason);
+
+        void on_connect_failed(OEBBStation& station, const char* reason);
+
+        void set_last_error(OEBBStation& station, const char* error);
+
+        /**
+         * @brief Sets the connection state under the mutex, get_connection_stats() may read it from another task.
+         */
+        void set_connection_state(OEBBStation& station, OEBBConnectionState state);
+
+        void reset_consecutive_failures(OEBBStation& station);
 
         void handle_deserialisation_error(DeserializationError& error);
         
@@ -41,9 +288,14 @@ class OEBBDeparture {
 
         bool is_connected();
 
-        void set_notification(TaskHandle_t task);
+        FrameRingStats get_frame_stats() const;
+
+        size_t get_station_count();
 
-        void get_latest_snapshot(std::vector<Monitor>& data);
+        /**
+         * @brief Health of the websocket session of a station, the uptime includes the current connection.
+         */
+        bool get_connection_stats(size_t idx, OEBBConnectionStats& stats);
 };
 
 #endif//__OEBB_H__
\ No newline at end of file
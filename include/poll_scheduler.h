@@ -0,0 +1,44 @@
+#ifndef __POLL_SCHEDULER_H__
+#define __POLL_SCHEDULER_H__
+
+#include <Arduino.h>
+#include <vector>
+
+#include "traffic.h"
+
+/**
+ * @brief Picks the delay until the next poll from the current departures.
+ *
+ * Polls faster while a departure is imminent, slower when the next departure
+ * is far away or nothing runs anymore, and backs off exponentially on errors.
+ */
+class PollScheduler {
+    private:
+        const char* name;
+        uint32_t consecutive_errors;
+        bool has_error;
+
+        /**
+         * @brief Minutes until the departure, extrapolated from its time as the published countdown is not refreshed.
+         */
+        static int current_countdown(const Vehicle& vehicle, time_t now);
+
+    public:
+        explicit PollScheduler(const char* name);
+
+        /**
+         * @brief Starts a new poll, errors are collected until next_delay().
+         */
+        void begin_poll();
+
+        void report_error();
+
+        /**
+         * @brief Calculates the delay until the next poll in milliseconds and logs the decision.
+         */
+        uint32_t next_delay(const std::vector<Monitor>& monitors);
+
+        uint32_t get_consecutive_errors() const;
+};
+
+#endif//__POLL_SCHEDULER_H__
@@ -16,8 +16,10 @@
 #define PARAM_ID_EVA "eva"
 #define PARAM_ID_FILTER_EVA "filter_eva"
 #define PARAM_ID_COUNT "lines_count"
+#define PARAM_ID_DISPLAY "display_mode"
 
 extern void task_screen_update(void* pvParameters);
+extern void action_rbl_changed();
 class PowerManager {
     private:
         WiFiManager wifi_manager;
@@ -21,8 +21,9 @@ private:
 
     const static constexpr char* EVAPrompt =
     "OEBB EVA:"
-    "<br>Find your EVA/IBNR on <a href='https://www.michaeldittrich.de/ibnr/online.php' target='_blank' title='EVA/IBNR Search'>https://www.michaeldittrich.de/ibnr/online.php</a>."
-    "<br>Example: \"810027\""
+    "<br>Find your EVA/IBNR on <a href='https://www.michaeldittrich.de/ibnr/online.php' target='_blank' title='EVA/IBNR Search'>https://www.michaeldittrich.de/ibnr/online.php</a>. Up to 3 EVAs can be combined by comma-separating them:"
+    "<br>Example Single: \"810027\""
+    "<br>Example Multiple: \"810027,8101590\""
     "<br><br><b>EVA:</b>";
 
    /**
@@ -31,15 +32,19 @@ private:
    const static constexpr char* RBLFilterPrompt =
     "<i>Optional.</i>"
     "Filter the lines to show by comma-separating the line numbers."
-    "If empty, all directions will be shown.<br>"
-    "Example: \"D,2,U2Z,43\".<br><br>"
+    "If empty, all directions will be shown. "
+    "A direction can be selected with \"line:direction\", "
+    "'*' and '?' match any characters or a single one.<br>"
+    "Example: \"D,2,U2Z,43,U1:Leopoldau,N*\".<br><br>"
     "<b>Filter RBL:</b>";
 
    const static constexpr char* EVAFilterPrompt =
     "<i>Optional.</i>"
     "Filter the lines to show by comma-separating the line numbers."
-    "If empty, all directions will be shown.<br>"
-    "Example: \"S45,S3\".<br><br>"
+    "If empty, all directions will be shown. "
+    "A direction can be selected with \"line:direction\", "
+    "'*' and '?' match any characters or a single one.<br>"
+    "Example: \"S45,S3,S4?,REX*:Wien\".<br><br>"
     "<b>Filter EVA:</b>";
 
    const static constexpr char* EcoPrompt = 
@@ -49,6 +54,12 @@ private:
       "<br>&nbsp;&nbsp;3=Heavy [Disply Off + CPU Limit + WiFi Off]"
       "<br>Example: \"1\".<br><br><b>Power Save Mode:</b>";
 
+   const static constexpr char* DisplayModePrompt =
+      "Select what is shown on the screen."
+      "<br>&nbsp;&nbsp;0=Monitors [One row per line and stop]"
+      "<br>&nbsp;&nbsp;1=Next Departures [The soonest departures of all lines first]"
+      "<br>Example: \"0\".<br><br><b>Display Mode:</b>";
+
   public:
   /**
      * @brief Get the Wi-Fi SSID string.
@@ -74,6 +85,8 @@ private:
    
    static String GetPowerModePrompt();
 
+   static String GetDisplayModePrompt();
+
    /**
      * @brief Get the prompt for specifying the number of lines to show.
      * @param min The minimum number of lines.
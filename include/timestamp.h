@@ -0,0 +1,15 @@
+#ifndef __TIMESTAMP_H__
+#define __TIMESTAMP_H__
+
+#include <time.h>
+
+time_t timegm(struct tm *const t);
+
+/**
+ * @brief Parses an ISO-8601 timestamp, e.g. "2024-05-01T10:00:30.000+0200" or "2024-05-01T08:00:30Z".
+ *
+ * @return Seconds since the epoch or 0 if the format is not recognised.
+ */
+time_t parse_timestamp(const char* s);
+
+#endif//__TIMESTAMP_H__
@@ -1,15 +1,19 @@
 #ifndef __TRAFFIC_H__
 #define __TRAFFIC_H__
 
+#include <atomic>
 #include <map>
+#include <memory>
 
-template<typename T> std::vector<T> cyclicSubset(const std::vector<T>& input, size_t N, size_t start);
+#include "config.h"
+#include "screen.h"
 
 struct Vehicle {
     String line;
     String towards;
     String remark;
     int countdown;
+    time_t departure;                 // Expected departure (epoch), 0 if unknown
     bool is_barrier_free;
     bool has_folding_ramp;
     bool is_cancelled;
@@ -58,6 +62,20 @@ struct Monitor {
 
   };
 
+// Published data of a source, immutable and shared by reference with all readers
+typedef std::shared_ptr<const std::vector<Monitor>> MonitorSnapshot;
+
+struct SourceSnapshot {
+    MonitorSnapshot monitors;
+    uint32_t version = 0;  // Incremented with every published snapshot, 0 if none was published
+};
+
+// Counts the updates of a source that were skipped because nothing visible changed
+struct ContentHashStats {
+    uint32_t unchanged = 0;
+    uint32_t changed = 0;
+};
+
 class TrafficClock {
     private:
         const unsigned long kMillisecondsPerCountdown = 5000;
@@ -85,18 +103,162 @@ class TrafficClock {
         void PrintTime() const;
 };
 
+/**
+ * @brief Monitors of one page, pointing into the model of the TraficManager.
+ *
+ * The rows are kept in a fixed array, so building a page every frame does
+ * not allocate. A page is only valid until the model is replaced.
+ */
+class MonitorPage {
+    private:
+        const Monitor* rows[LIMIT_MAX_NUMBER_LINES];
+        size_t count;
+
+    public:
+        explicit MonitorPage();
+
+        /**
+         * @brief Takes count monitors from start on, wrapping around at the end of the vector.
+         */
+        void assign(const std::vector<Monitor>& monitors, size_t count, size_t start);
+
+        /**
+         * @brief Sorts the rows by the first countdown of each monitor.
+         */
+        void sort();
+
+        size_t size() const;
+
+        bool empty() const;
+
+        const Monitor& operator[](size_t idx) const;
+};
+
+struct RenderStats {
+    uint32_t frames = 0;
+    uint32_t allocations = 0;  // Heap allocations during frames, only counted with ALLOC_COUNTER
+    uint32_t page_changes = 0;
+    uint32_t plans = 0;
+    uint32_t entity_builds = 0;  // Frames that had to generate their rows
+};
+
+struct ScreenEntityKey {
+    uint32_t model_version;
+    const MonitorPage* page;        // nullptr in the next departures mode
+    size_t first_departure;         // 0 in the monitors mode
+    int countdown_idx;
+    int rows;
+    bool is_blink_on;               // Always false if no row is due
+
+    bool operator==(const ScreenEntityKey& other) const {
+        return model_version == other.model_version && page == other.page && first_departure == other.first_departure
+            && countdown_idx == other.countdown_idx
+            && rows == other.rows && is_blink_on == other.is_blink_on;
+    }
+};
+
+struct Departure {
+    const Monitor* monitor;
+    const Vehicle* vehicle;
+};
+
+/**
+ * @brief The next departures of all monitors in chronological order.
+ *
+ * The vehicles of every monitor are already sorted, so the list is a k-way
+ * merge with a heap holding the next vehicle of each monitor. Taking n
+ * departures out of k monitors costs O(n log k). The entries point into the
+ * model and are only valid until its vehicles change.
+ */
+class DepartureList {
+    private:
+        struct Cursor {
+            int countdown;
+            size_t monitor;
+            size_t vehicle;
+        };
+        std::vector<Cursor> heap;
+        std::vector<Departure> departures;
+
+        // Heap order, the soonest departure is on top and ties keep the order of the monitors
+        static bool is_later(const Cursor& a, const Cursor& b);
+
+    public:
+        /**
+         * @brief Merges the first limit departures, the buffers keep their capacity.
+         */
+        void build(const std::vector<Monitor>& monitors, size_t limit);
+
+        size_t size() const;
+
+        bool empty() const;
+
+        const Departure& operator[](size_t idx) const;
+};
+
+/**
+ * @brief Page sequence of the model, built when the data or the number of rows changes.
+ *
+ * Each page shows the monitors from shift_cnt on, the next one starts a
+ * screen further. The frame loop only advances the index of the current page.
+ */
+struct PagePlan {
+    int rows = 0;
+    DisplayMode mode = DISPLAY_MONITORS;
+    size_t page = 0;
+    size_t page_count = 0;           // 0 until the plan is built for the current model
+    std::vector<MonitorPage> pages;  // Empty in the next departures mode, a page is a slice of the list
+};
+
+/**
+ * @brief Model of the departures shown on the screen.
+ *
+ * The model is owned by the screen task. update() builds the next one on the
+ * caller's task and hands it over by exchanging a pointer, the screen task
+ * adopts it at the start of its next frame. Neither side takes a lock.
+ */
 class TraficManager {
     private:
+        // Only touched by the screen task
         std::vector<Monitor> all_trafic_set;
-        SemaphoreHandle_t internal_mutex;
+        // Published by update(), nullptr once the screen task took it
+        std::atomic<std::vector<Monitor>*> pending_trafic_set;
         int shift_cnt;
         int countdown_idx;
         TrafficClock* p_trafic_clock;
         long prev_iterations = 0;
+        time_t last_countdown_update = 0;
+        PagePlan page_plan;
+        // Only maintained in the next departures mode
+        DepartureList next_departures;
+        // Incremented whenever the plan is rebuilt or the countdowns change
+        uint32_t model_version;
+        // Rows of the last frame, reused while their key does not change
+        std::vector<ScreenEntity> screen_entities;
+        ScreenEntityKey screen_entity_key = {};
+        // The rows only follow the blinking while one of them shows a due departure
+        bool has_due_rows = false;
+        RenderStats render_stats;
 
         explicit TraficManager();
         ~TraficManager();
 
+        /**
+         * @brief Takes the model published by update(), if there is one.
+         */
+        void adopt_pending();
+
+        /**
+         * @brief Computes the pages and the dwell times of the current model.
+         */
+        void build_plan(int rows);
+
+        void render_frame();
+
+        void build_screen_entities(const MonitorPage& currentTrafficSubset);
+
+        void build_departure_entities(size_t first_departure);
+
     public:
         static TraficManager& getInstance();
 
@@ -107,9 +269,6 @@ class TraficManager {
         int last_min_size = -1;  // Initialize last_min_size to an invalid value
         std::map<String, std::vector<String>> SplittedStringCache;
 
-        BaseType_t acquire();
-        void release();
-
         bool hasClock();
 
         void deleteClock();
@@ -118,17 +277,31 @@ class TraficManager {
 
         bool has_data();
 
-        void update(const std::vector<Monitor>& vec);
+        /**
+         * @brief Publishes the monitors for the next frame, never waits for the screen task.
+         */
+        void update(std::vector<Monitor>&& vec);
+
+        /**
+         * @brief Recomputes the countdowns from the departure times and the NTP-synced clock.
+         * @return True if a countdown changed or a vehicle departed.
+         */
+        bool updateCountdowns();
 
         void updateScreen();
 
-        void SelectiveReset(const std::vector<Monitor>& currentTraficSubset, const std::vector<Monitor>& futureSubset);
+        RenderStats get_render_stats() const;
 
-        void sortTrafic(std::vector<Monitor>& v);
+        void SelectiveReset(const MonitorPage& currentTraficSubset, const MonitorPage& futureSubset);
 
         String GetValidCountdown(const std::vector<Vehicle>& c, size_t index);
 
-        void DrawTraficOnScreen(const std::vector<Monitor>& currentTrafficSubset);
+        void DrawTraficOnScreen(const MonitorPage& currentTrafficSubset);
+
+        /**
+         * @brief Draws a page of the merged departures, one departure per row.
+         */
+        void DrawDeparturesOnScreen(size_t page);
 
         std::vector<String> getSplittedStringFromCache(const String& key_string);
 
@@ -139,6 +312,68 @@ class TraficManager {
         std::vector<String> splitToString(const String& input);
 };
 
-Monitor* findMonitor(std::vector<Monitor>& monitors, const String& line_name, const String& stop_name);
+/**
+ * @brief Open-addressing index over a vector of monitors keyed by (line, stop).
+ *
+ * Used while a payload is ingested to merge departures of the same line and
+ * stop in constant time. The vector must only grow through insert().
+ */
+class MonitorIndex {
+    private:
+        struct Slot {
+            uint32_t hash;
+            int32_t idx;
+        };
+        std::vector<Monitor>* monitors;
+        std::vector<Slot> slots;
+        size_t count;
+
+        static uint32_t hash(const String& line_name, const String& stop_name);
+
+        void insert_slot(uint32_t hash, int32_t idx);
+
+        void grow();
+
+    public:
+        explicit MonitorIndex();
+
+        /**
+         * @brief Indexes all monitors already in the vector.
+         */
+        void attach(std::vector<Monitor>& monitors);
+
+        Monitor* find(const String& line_name, const String& stop_name);
+
+        /**
+         * @brief Appends the monitor to the vector and indexes it.
+         */
+        Monitor* insert(const Monitor& monitor);
+
+        Monitor* insert(Monitor&& monitor);
+};
+
+/**
+ * @brief Maps a line name to the first traffic info it is related to.
+ */
+class TrafficInfoIndex {
+    private:
+        struct Slot {
+            uint32_t hash;
+            int32_t idx;
+            const String* line;
+        };
+        const std::vector<TrafficInfo>* infos;
+        std::vector<Slot> slots;
+
+    public:
+        explicit TrafficInfoIndex();
+
+        /**
+         * @brief Builds the index, the infos must not change while it is used.
+         */
+        void build(const std::vector<TrafficInfo>& infos);
+
+        const TrafficInfo* find(const String& line_name) const;
+};
 
 #endif//__TRAFFIC_H__
\ No newline at end of file
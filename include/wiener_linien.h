@@ -4,37 +4,186 @@
 #include <HTTPClient.h>
 #include <WiFi.h>
 
+#include "departure_source.h"
 #include "json.h"
+#include "json_stream.h"
+#include "poll_scheduler.h"
 #include "traffic.h"
 
-#define URL_WIENER_LINIEN "https://www.wienerlinien.at/ogd_realtime/monitor?activateTrafficInfo=stoerunglang&rbl="
+#define HOST_WIENER_LINIEN "www.wienerlinien.at"
+#define URL_WIENER_LINIEN "https://www.wienerlinien.at/ogd_realtime/monitor?rbl="
+#define URL_WIENER_LINIEN_TRAFFIC_INFO "https://www.wienerlinien.at/ogd_realtime/trafficInfoList?name=stoerunglang"
+#define TRAFFIC_INFO_UPDATE_DELAY (600000)
+// RBLs are split into several requests so a single response stays small
+#define WL_MAX_URL_LENGTH (160)
 
-class WLDeparture {
+enum WLKey : uint8_t {
+    WL_KEY_UNKNOWN = JSON_KEY_UNKNOWN,
+    WL_KEY_DATA,
+    WL_KEY_MONITORS,
+    WL_KEY_LOCATION_STOP,
+    WL_KEY_PROPERTIES,
+    WL_KEY_TITLE,
+    WL_KEY_LINES,
+    WL_KEY_NAME,
+    WL_KEY_TOWARDS,
+    WL_KEY_BARRIER_FREE,
+    WL_KEY_FOLDING_RAMP,
+    WL_KEY_DEPARTURES,
+    WL_KEY_DEPARTURE,
+    WL_KEY_DEPARTURE_TIME,
+    WL_KEY_COUNTDOWN,
+    WL_KEY_TIME_PLANNED,
+    WL_KEY_TIME_REAL,
+    WL_KEY_VEHICLE,
+    WL_KEY_TRAFFIC_INFOS,
+    WL_KEY_DESCRIPTION,
+    WL_KEY_RELATED_LINES
+};
+
+/**
+ * @brief Builds the monitors from the events of the JsonStreamParser.
+ *
+ * Only the line that is currently parsed is buffered, every finished line
+ * is merged directly into the output vector.
+ */
+class WLMonitorParser : public JsonStreamHandler {
+    private:
+        std::vector<Monitor>& monitors;
+        const LineFilter* filter;
+        bool is_line_rejected;
+        std::vector<TrafficInfo> traffic_infos;
+        MonitorIndex monitor_index;
+        std::vector<String> related_lines;
+        String stop_name;
+        Monitor line;
+        Vehicle vehicle;
+        bool has_departure_time;
+        TrafficInfo traffic_info;
+        size_t monitor_count;
+        uint32_t content_hash;
+
+        static String fix_json(const String& word);
+
+        void merge_line();
+
+        bool is_related(const TrafficInfo& info) const;
+
+        void update_hash(uint8_t key, const char* data, size_t length);
+
+    public:
+        explicit WLMonitorParser(std::vector<Monitor>& monitors);
+
+        /**
+         * @brief Clears the output vector and prepares for a new response.
+         */
+        void begin(const LineFilter& filter);
+
+        /**
+         * @brief Only keeps traffic infos related to one of the lines.
+         */
+        void set_related_lines(const std::vector<String>& lines);
+
+        std::vector<TrafficInfo>& get_traffic_infos();
+
+        uint8_t map_key(const char* key, size_t length) override;
+
+        void on_begin(const JsonStreamPath& path, bool is_array) override;
+
+        void on_end(const JsonStreamPath& path, bool is_array) override;
+
+        void on_value(const JsonStreamPath& path, JsonStreamValue type, const char* value, size_t length) override;
+
+        void on_document_end() override;
+
+        /**
+         * @brief Hash over all values the monitors are built from.
+         */
+        uint32_t get_content_hash() const;
+};
+
+struct ConnectionStats {
+    uint32_t handshakes = 0;
+    uint32_t failed_handshakes = 0;
+    uint32_t reused_connections = 0;
+    uint32_t stale_retries = 0;  // Requests repeated after the server had closed the reused connection
+    unsigned long last_handshake_ms = 0;
+    unsigned long max_handshake_ms = 0;
+    unsigned long total_handshake_ms = 0;
+};
+
+class WLDeparture : public DepartureSource {
     private:
         WiFiClientSecure secure_client;
-        SemaphoreHandle_t internal_mutex;
+        HTTPClient https;
+        ConnectionStats connection_stats;
         TimerHandle_t handle_timer_update;
         TaskHandle_t handle_task_update;
-        TaskHandle_t notification;
-        std::vector<Monitor> monitors;
-    
-        String fix_json(const String& word);
+        // Parsed into while the response is received, swapped into its shard afterwards
+        std::vector<Monitor> pending_monitors;
+        // Latest results of each request, merged into the snapshot
+        std::vector<std::vector<Monitor>> shard_monitors;
+        std::vector<uint32_t> shard_hashes;
+        std::vector<String> shard_urls;
+        String shard_rbl;
+        MonitorIndex publish_index;
+        // Disruptions are fetched less often than the departures and joined by line
+        std::vector<TrafficInfo> traffic_info_cache;
+        TrafficInfoIndex traffic_info_index;
+        uint32_t traffic_info_hash;
+        unsigned long traffic_info_updated;
+        JsonStreamParser stream_parser;
+        WLMonitorParser monitor_parser;
+        PollScheduler scheduler;
 
         static void task_update(void * pvParameters);
 
         static void callback_timer_update(TimerHandle_t xTimer);
 
-        void fill_monitors_from_json(JsonDocument& root);
+        /**
+         * @brief Reuses the open TLS connection or performs a new handshake.
+         */
+        bool connect();
+
+        /**
+         * @brief Sends a GET request, once more with a new handshake if the reused connection was closed.
+         * @return The HTTP code, the response is read through https.
+         */
+        int send_request(const String& url);
+
+        void poll(const String& rbl);
+
+        void schedule_next_poll();
+
+        /**
+         * @brief Splits the comma-separated RBLs into request URLs of bounded length.
+         */
+        void build_shards(const String& rbl);
+
+        bool fetch_shard(size_t idx);
+
+        void publish_shards();
+
+        /**
+         * @brief True if no shard has a monitor.
+         */
+        bool is_empty() const;
+
+        bool is_traffic_info_due();
+
+        bool fetch_traffic_infos();
 
     public:
         explicit WLDeparture();
 
         void setup();
 
-        void set_notification(TaskHandle_t task);
-
-        void get_latest_snapshot(std::vector<Monitor>& data);
+        /**
+         * @brief Moves the next poll forward, e.g. after WiFi returned or the RBLs changed.
+         */
+        void request_poll();
 
+        ConnectionStats get_connection_stats();
 };
 
 #endif//__WIENER_LINIEN_H__
\ No newline at end of file
@@ -0,0 +1,38 @@
+#include "alloc_counter.h"
+
+#ifdef ALLOC_COUNTER
+
+#ifndef CONFIG_HEAP_USE_HOOKS
+#error "ALLOC_COUNTER needs a framework built with CONFIG_HEAP_USE_HOOKS"
+#endif
+
+static TaskHandle_t watched_task = nullptr;
+// Only written by the watched task
+static uint32_t allocation_count = 0;
+
+void alloc_counter_watch(TaskHandle_t task) {
+    allocation_count = 0;
+    watched_task = task;
+}
+
+uint32_t alloc_counter_get() {
+    return allocation_count;
+}
+
+// Called by the heap for every allocation, malloc, heap_caps_malloc and operator new alike
+extern "C" void esp_heap_trace_alloc_hook(void* ptr, size_t size, uint32_t caps) {
+    if (watched_task != nullptr && xTaskGetCurrentTaskHandle() == watched_task) {
+        allocation_count++;
+    }
+}
+
+#else
+
+void alloc_counter_watch(TaskHandle_t task) {
+}
+
+uint32_t alloc_counter_get() {
+    return 0;
+}
+
+#endif
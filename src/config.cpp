@@ -1,6 +1,6 @@
 #include "config.h"
 
-Configuration::Configuration() : ram_eco_mode(ECO_LIGHT), ram_eco_state(ECO_OFF), ram_brightness(100.0) {}
+Configuration::Configuration() : ram_eco_mode(ECO_LIGHT), ram_eco_state(ECO_OFF), ram_brightness(100.0), ram_display_mode(DISPLAY_MONITORS) {}
 
 Configuration& Configuration::getInstance() {
     static Configuration instance;
@@ -18,6 +18,7 @@ void Configuration::load() {
     this->ram_eco_mode = static_cast<EcoMode>(this->db.getInt(PREF_ECO_MODE, ECO_LIGHT));
     this->ram_eco_state = static_cast<EcoModeState>(this->db.getInt(PREF_ECO_STATE, ECO_OFF));
     this->ram_brightness = this->db.getDouble(PREF_BRIGHTNESS, 100.0);
+    this->ram_display_mode = this->verify_display_mode(this->db.getInt(PREF_DISPLAY_MODE, DISPLAY_MONITORS));
     this->end();
 }
 
@@ -25,6 +26,10 @@ void Configuration::clear() {
     this->begin();
     this->db.clear();
     this->end();
+    Preferences stations;
+    stations.begin(NS_STATIONS);
+    stations.clear();
+    stations.end();
 }
 
 void Configuration::begin(bool read_only) {
@@ -147,3 +152,62 @@ void Configuration::set_brightness(double value) {
 double Configuration::get_brightness() {
     return this->ram_brightness;
 }
+
+DisplayMode Configuration::verify_display_mode(int32_t value) {
+    switch (value) {
+      case DISPLAY_NEXT_DEPARTURES:
+        return DISPLAY_NEXT_DEPARTURES;
+      default:
+        return DISPLAY_MONITORS;
+    }
+}
+
+void Configuration::set_display_mode(int32_t value) {
+    this->ram_display_mode = this->verify_display_mode(value);
+    this->begin();
+    this->db.putInt(PREF_DISPLAY_MODE, static_cast<int32_t>(this->ram_display_mode));
+    this->end();
+}
+
+DisplayMode Configuration::get_display_mode() {
+    return this->ram_display_mode;
+}
+
+String Configuration::station_key(const String& eva) {
+    // NVS keys are limited to 15 characters
+    return eva.length() <= 12 ? "st_" + eva : String();
+}
+
+bool Configuration::get_station(const String& eva, StationInfo& info) {
+    String key = station_key(eva);
+    if (!key.length()) {
+        return false;
+    }
+    Preferences stations;
+    stations.begin(NS_STATIONS, true);
+    String entry = stations.getString(key.c_str());
+    stations.end();
+    // Format: "<version>|<updated>|<plc>|<name>", the name is last as it might contain the separator
+    int first = entry.indexOf('|');
+    int second = entry.indexOf('|', first + 1);
+    int third = entry.indexOf('|', second + 1);
+    if (first == -1 || second == -1 || third == -1 || entry.substring(0, first).toInt() != STATION_CACHE_VERSION) {
+        return false;
+    }
+    info.updated = static_cast<time_t>(entry.substring(first + 1, second).toInt());
+    info.plc = entry.substring(second + 1, third);
+    info.name = entry.substring(third + 1);
+    return info.plc.length() > 0;
+}
+
+void Configuration::set_station(const String& eva, const StationInfo& info) {
+    String key = station_key(eva);
+    if (!key.length()) {
+        return;
+    }
+    String entry = String(STATION_CACHE_VERSION) + "|" + String(static_cast<long>(info.updated)) + "|" + info.plc + "|" + info.name;
+    Preferences stations;
+    stations.begin(NS_STATIONS);
+    stations.putString(key.c_str(), entry);
+    stations.end();
+}
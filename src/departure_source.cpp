@@ -0,0 +1,137 @@
+#include <algorithm>
+#include <HTTPClient.h>
+
+#include "departure_source.h"
+
+void sort_vehicles(std::vector<Vehicle>& vehicles) {
+    // sort vehicles by arriving time
+    std::sort(
+        vehicles.begin(), vehicles.end(),
+        [](const Vehicle& a, const Vehicle& b) {
+            return a.countdown < b.countdown;
+        }
+    );
+}
+
+void merge_monitor(MonitorIndex& index, const Monitor& monitor) {
+    Monitor* monitor_p = index.find(monitor.line, monitor.stop);
+    if (monitor_p) {
+        //Monitor with line name already exists -> different towards
+        monitor_p->vehicles.insert(monitor_p->vehicles.end(), monitor.vehicles.begin(), monitor.vehicles.end());
+        sort_vehicles(monitor_p->vehicles);
+    } else {
+        // New monitor with linename and stop
+        index.insert(monitor);
+    }
+}
+
+void merge_monitor(MonitorIndex& index, Monitor&& monitor) {
+    Monitor* monitor_p = index.find(monitor.line, monitor.stop);
+    if (monitor_p) {
+        monitor_p->vehicles.insert(monitor_p->vehicles.end(), monitor.vehicles.begin(), monitor.vehicles.end());
+        sort_vehicles(monitor_p->vehicles);
+    } else {
+        index.insert(std::move(monitor));
+    }
+}
+
+DepartureSource::DepartureSource(const char* name)
+    : name(name), notification(nullptr), snapshot(std::make_shared<const std::vector<Monitor>>()), snapshot_version(0), internal_mutex(nullptr) {
+    this->internal_mutex = xSemaphoreCreateMutex();
+}
+
+void DepartureSource::restart_if_refused(int http_code) {
+    if (http_code == HTTPC_ERROR_CONNECTION_REFUSED) {
+        // We restart to reset the heap
+        ESP.restart();
+    }
+}
+
+bool DepartureSource::is_content_changed(uint32_t& published_hash, uint32_t hash) {
+    if (hash == published_hash) {
+        // Same departures as last time, the screen keeps its state
+        this->hash_stats.unchanged++;
+        Serial.printf("[%s] Update unchanged, skipped (%d unchanged, %d changed).\n", this->name, this->hash_stats.unchanged, this->hash_stats.changed);
+        return false;
+    }
+    this->hash_stats.changed++;
+    published_hash = hash;
+    return true;
+}
+
+std::shared_ptr<std::vector<Monitor>> DepartureSource::acquire_buffer() {
+    std::shared_ptr<std::vector<Monitor>> result;
+    if (xSemaphoreTake(this->internal_mutex, portMAX_DELAY) != pdTRUE) {
+        return std::make_shared<std::vector<Monitor>>();
+    }
+    std::shared_ptr<std::vector<Monitor>>* unused = nullptr;
+    for (auto& buffer : this->buffers) {
+        if (!buffer) {
+            unused = &buffer;
+        } else if (buffer.use_count() == 1) {
+            // Neither published nor held by a reader, the capacity is kept
+            result = buffer;
+            this->snapshot_stats.buffer_reuses++;
+            break;
+        }
+    }
+    if (!result) {
+        this->snapshot_stats.buffer_allocations++;
+        result = std::make_shared<std::vector<Monitor>>();
+        if (unused != nullptr) {
+            *unused = result;
+        }
+    }
+    xSemaphoreGive(this->internal_mutex);
+    // Cleared without the lock, the monitors of an old snapshot can take a while to free
+    result->clear();
+    return result;
+}
+
+void DepartureSource::publish(const std::shared_ptr<std::vector<Monitor>>& monitors) {
+    if (xSemaphoreTake(this->internal_mutex, portMAX_DELAY) != pdTRUE) {
+        return;
+    }
+    this->snapshot = monitors;
+    const uint32_t version = ++this->snapshot_version;
+    this->snapshot_stats.published++;
+    xSemaphoreGive(this->internal_mutex);
+    // Notify data coordinator of data update
+    if (this->notification != nullptr) {
+        xTaskNotifyGive(this->notification);
+    } else {
+        Serial.println(F("Data update notification skipped."));
+    }
+    Serial.printf("[%s] Published %d monitors (snapshot %u).\n", this->name, monitors->size(), version);
+}
+
+void DepartureSource::set_notification(TaskHandle_t task) {
+    this->notification = task;
+}
+
+void DepartureSource::get_latest_snapshot(SourceSnapshot& data) {
+    // Lock briefly just to share the published vector
+    if (xSemaphoreTake(this->internal_mutex, portMAX_DELAY) == pdTRUE) {
+        data.monitors = this->snapshot;
+        data.version = this->snapshot_version;
+        xSemaphoreGive(this->internal_mutex);
+    }
+}
+
+ContentHashStats DepartureSource::get_content_hash_stats() {
+    ContentHashStats stats;
+    if (xSemaphoreTake(this->internal_mutex, portMAX_DELAY) == pdTRUE) {
+        stats = this->hash_stats;
+        xSemaphoreGive(this->internal_mutex);
+    }
+    return stats;
+}
+
+SnapshotStats DepartureSource::get_snapshot_stats() {
+    SnapshotStats stats;
+    if (xSemaphoreTake(this->internal_mutex, portMAX_DELAY) == pdTRUE) {
+        stats = this->snapshot_stats;
+        xSemaphoreGive(this->internal_mutex);
+    }
+    return stats;
+}
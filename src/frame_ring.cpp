@@ -0,0 +1,92 @@
+#include <esp_heap_caps.h>
+
+#include "frame_ring.h"
+
+FrameRing::FrameRing(const char* name, size_t slot_size, size_t slot_count)
+    : name(name), buffer(nullptr), slot_size(slot_size), slot_count(slot_count), slots(nullptr), head(0), tail(0),
+      pushed(0), popped(0), overruns(0), oversized(0), max_frame_size(0) {}
+
+FrameRing::~FrameRing() {
+    if (this->buffer != nullptr) {
+        heap_caps_free(this->buffer);
+    }
+    delete[] this->slots;
+}
+
+bool FrameRing::begin() {
+    if (this->buffer == nullptr) {
+        // Too large for the internal heap, the ring is only usable with PSRAM
+        this->buffer = static_cast<uint8_t*>(
+            heap_caps_malloc(this->slot_size * this->slot_count, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT)
+        );
+        if (this->buffer == nullptr) {
+            Serial.printf("[Ring] Could not allocate %d bytes for %s.\n", this->slot_size * this->slot_count, this->name);
+            return false;
+        }
+        this->slots = new FrameRingSlot[this->slot_count]();
+    }
+    return true;
+}
+
+uint8_t* FrameRing::slot(uint32_t index) const {
+    return this->buffer + (index % this->slot_count) * this->slot_size;
+}
+
+bool FrameRing::push(const uint8_t* data, size_t length, uint8_t tag) {
+    // Only the producer writes it, so no compare-exchange is needed
+    if (length > this->max_frame_size.load(std::memory_order_relaxed)) {
+        this->max_frame_size.store(length, std::memory_order_relaxed);
+    }
+    // One byte is needed for the terminator
+    if (this->buffer == nullptr || length >= this->slot_size) {
+        this->oversized.fetch_add(1, std::memory_order_relaxed);
+        Serial.printf("[Ring] %s: dropped frame of %d bytes.\n", this->name, length);
+        return false;
+    }
+    uint32_t head = this->head.load(std::memory_order_relaxed);
+    if (head - this->tail.load(std::memory_order_acquire) >= this->slot_count) {
+        this->overruns.fetch_add(1, std::memory_order_relaxed);
+        Serial.printf("[Ring] %s: overrun, %d frames are pending.\n", this->name, this->slot_count);
+        return false;
+    }
+    uint8_t* target = this->slot(head);
+    memcpy(target, data, length);
+    target[length] = '\0';
+    this->slots[head % this->slot_count].length = length;
+    this->slots[head % this->slot_count].tag = tag;
+    this->pushed.fetch_add(1, std::memory_order_relaxed);
+    // Publishes the frame to the consumer
+    this->head.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+char* FrameRing::front(size_t& length, uint8_t& tag) {
+    uint32_t tail = this->tail.load(std::memory_order_relaxed);
+    if (this->head.load(std::memory_order_acquire) == tail) {
+        length = 0;
+        return nullptr;
+    }
+    length = this->slots[tail % this->slot_count].length;
+    tag = this->slots[tail % this->slot_count].tag;
+    return reinterpret_cast<char*>(this->slot(tail));
+}
+
+void FrameRing::pop() {
+    uint32_t tail = this->tail.load(std::memory_order_relaxed);
+    if (this->head.load(std::memory_order_acquire) == tail) {
+        return;
+    }
+    this->popped.fetch_add(1, std::memory_order_relaxed);
+    // Hands the slot back to the producer
+    this->tail.store(tail + 1, std::memory_order_release);
+}
+
+FrameRingStats FrameRing::get_stats() const {
+    FrameRingStats stats;
+    stats.pushed = this->pushed.load(std::memory_order_relaxed);
+    stats.popped = this->popped.load(std::memory_order_relaxed);
+    stats.overruns = this->overruns.load(std::memory_order_relaxed);
+    stats.oversized = this->oversized.load(std::memory_order_relaxed);
+    stats.max_frame_size = this->max_frame_size.load(std::memory_order_relaxed);
+    return stats;
+}
@@ -0,0 +1,119 @@
+#include <esp_heap_caps.h>
+
+#include "json_arena.h"
+
+// Every block is prefixed with its size, needed to copy it on reallocation
+#define ARENA_ALIGNMENT (8)
+#define ARENA_HEADER_SIZE (ARENA_ALIGNMENT)
+
+static_assert(sizeof(size_t) <= ARENA_HEADER_SIZE, "Arena header too small");
+
+static inline size_t align_size(size_t size) {
+    return (size + ARENA_ALIGNMENT - 1) & ~static_cast<size_t>(ARENA_ALIGNMENT - 1);
+}
+
+static void* psram_malloc(size_t size) {
+    void* ptr = heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (ptr == nullptr) {
+        // No PSRAM available, fall back to the internal heap
+        ptr = malloc(size);
+    }
+    return ptr;
+}
+
+JsonArena::JsonArena(const char* name, size_t capacity)
+    : name(name), buffer(nullptr), capacity(capacity), used(0), last_offset(0), high_water_mark(0), reported_high_water_mark(0), failed_allocations(0) {}
+
+JsonArena::~JsonArena() {
+    if (this->buffer != nullptr) {
+        heap_caps_free(this->buffer);
+    }
+}
+
+bool JsonArena::ensure_buffer() {
+    // Allocated lazily because PSRAM might not be initialised yet when global objects are constructed
+    if (this->buffer == nullptr) {
+        this->buffer = static_cast<uint8_t*>(psram_malloc(this->capacity));
+        if (this->buffer == nullptr) {
+            Serial.printf("[Arena] Could not allocate %d bytes for %s.\n", this->capacity, this->name);
+        }
+    }
+    return this->buffer != nullptr;
+}
+
+size_t JsonArena::block_size(const void* ptr) {
+    return *reinterpret_cast<const size_t*>(static_cast<const uint8_t*>(ptr) - ARENA_HEADER_SIZE);
+}
+
+void* JsonArena::allocate(size_t size) {
+    size_t required = ARENA_HEADER_SIZE + align_size(size);
+    if (!this->ensure_buffer() || this->capacity - this->used < required) {
+        this->failed_allocations++;
+        return nullptr;
+    }
+    uint8_t* block = this->buffer + this->used;
+    *reinterpret_cast<size_t*>(block) = size;
+    this->last_offset = this->used;
+    this->used += required;
+    if (this->used > this->high_water_mark) {
+        this->high_water_mark = this->used;
+    }
+    return block + ARENA_HEADER_SIZE;
+}
+
+void JsonArena::deallocate(void* ptr) {
+    // Memory is released all at once by reset()
+}
+
+void* JsonArena::reallocate(void* ptr, size_t new_size) {
+    if (ptr == nullptr) {
+        return this->allocate(new_size);
+    }
+    uint8_t* block = static_cast<uint8_t*>(ptr) - ARENA_HEADER_SIZE;
+    if (block == this->buffer + this->last_offset) {
+        // The most recent block can grow or shrink in place
+        size_t required = ARENA_HEADER_SIZE + align_size(new_size);
+        if (this->capacity - this->last_offset < required) {
+            this->failed_allocations++;
+            return nullptr;
+        }
+        *reinterpret_cast<size_t*>(block) = new_size;
+        this->used = this->last_offset + required;
+        if (this->used > this->high_water_mark) {
+            this->high_water_mark = this->used;
+        }
+        return ptr;
+    }
+    void* new_ptr = this->allocate(new_size);
+    if (new_ptr != nullptr) {
+        memcpy(new_ptr, ptr, std::min(block_size(ptr), new_size));
+    }
+    return new_ptr;
+}
+
+void JsonArena::reset() {
+    this->used = 0;
+    this->last_offset = 0;
+}
+
+size_t JsonArena::get_capacity() const {
+    return this->capacity;
+}
+
+size_t JsonArena::get_high_water_mark() const {
+    return this->high_water_mark;
+}
+
+uint32_t JsonArena::get_failed_allocations() const {
+    return this->failed_allocations;
+}
+
+void JsonArena::print_high_water_mark() {
+    if (this->high_water_mark > this->reported_high_water_mark) {
+        this->reported_high_water_mark = this->high_water_mark;
+        Serial.printf(
+            "[Arena] %s: new high water mark %d of %d bytes (%d failed allocations).\n",
+            this->name, this->high_water_mark, this->capacity, this->failed_allocations
+        );
+    }
+}
@@ -0,0 +1,274 @@
+#include "json_stream.h"
+
+static inline bool is_whitespace(char c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+static inline bool is_literal_char(char c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || c == '-' || c == '+' || c == '.' || c == 'E';
+}
+
+static inline int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+JsonStreamParser::JsonStreamParser() : handler(nullptr) {
+    this->reset(nullptr);
+}
+
+void JsonStreamParser::reset(JsonStreamHandler* handler) {
+    this->handler = handler;
+    this->state = S_VALUE;
+    this->is_key = false;
+    this->depth = 0;
+    this->token_length = 0;
+    this->unicode = 0;
+    this->unicode_digits = 0;
+    this->high_surrogate = 0;
+    this->bytes_fed = 0;
+}
+
+bool JsonStreamParser::is_done() const {
+    return this->state == S_DONE;
+}
+
+bool JsonStreamParser::has_error() const {
+    return this->state == S_ERROR;
+}
+
+size_t JsonStreamParser::get_bytes_fed() const {
+    return this->bytes_fed;
+}
+
+size_t JsonStreamParser::write(uint8_t c) {
+    return this->feed(&c, 1) ? 1 : 0;
+}
+
+size_t JsonStreamParser::write(const uint8_t* buffer, size_t size) {
+    // Returning less than size makes HTTPClient::writeToStream abort the transfer
+    return this->feed(buffer, size) ? size : 0;
+}
+
+bool JsonStreamParser::feed(const uint8_t* data, size_t length) {
+    if (this->handler == nullptr) {
+        this->state = S_ERROR;
+    }
+    for (size_t i = 0; i < length && this->state != S_ERROR; i++) {
+        if (!this->process(static_cast<char>(data[i]))) {
+            this->state = S_ERROR;
+        }
+    }
+    this->bytes_fed += length;
+    return this->state != S_ERROR;
+}
+
+void JsonStreamParser::append(char c) {
+    if (this->token_length < JSON_STREAM_MAX_STRING) {
+        this->token[this->token_length++] = c;
+    }
+}
+
+void JsonStreamParser::append_code_point(uint32_t cp) {
+    if (cp < 0x80) {
+        this->append(static_cast<char>(cp));
+    } else if (cp < 0x800) {
+        this->append(static_cast<char>(0xC0 | (cp >> 6)));
+        this->append(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else if (cp < 0x10000) {
+        this->append(static_cast<char>(0xE0 | (cp >> 12)));
+        this->append(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        this->append(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else {
+        this->append(static_cast<char>(0xF0 | (cp >> 18)));
+        this->append(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+        this->append(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        this->append(static_cast<char>(0x80 | (cp & 0x3F)));
+    }
+}
+
+bool JsonStreamParser::begin_container(bool array) {
+    if (this->depth >= JSON_STREAM_MAX_DEPTH) {
+        return false;
+    }
+    this->handler->on_begin(JsonStreamPath(this->keys, this->depth), array);
+    this->is_array[this->depth] = array;
+    this->keys[this->depth] = array ? JSON_KEY_ITEM : JSON_KEY_UNKNOWN;
+    this->depth++;
+    this->state = array ? S_ARRAY_FIRST : S_OBJECT_FIRST;
+    return true;
+}
+
+bool JsonStreamParser::end_container(bool array) {
+    if (this->depth == 0 || this->is_array[this->depth - 1] != array) {
+        return false;
+    }
+    this->depth--;
+    this->handler->on_end(JsonStreamPath(this->keys, this->depth), array);
+    this->end_value();
+    return true;
+}
+
+void JsonStreamParser::end_value() {
+    if (this->depth == 0) {
+        this->state = S_DONE;
+        this->handler->on_document_end();
+    } else {
+        this->state = S_AFTER_VALUE;
+    }
+}
+
+void JsonStreamParser::emit_string() {
+    // Don't hand out a multibyte character that was cut off by the truncation
+    size_t length = this->token_length;
+    if (length == JSON_STREAM_MAX_STRING) {
+        size_t lead = length;
+        while (lead > 0 && (this->token[lead - 1] & 0xC0) == 0x80) lead--;
+        if (lead > 0 && (this->token[lead - 1] & 0x80)) {
+            uint8_t c = static_cast<uint8_t>(this->token[lead - 1]);
+            size_t expected = (c >= 0xF0) ? 4 : (c >= 0xE0) ? 3 : 2;
+            if (length - (lead - 1) < expected) length = lead - 1;
+        }
+    }
+    this->token[length] = '\0';
+    if (this->is_key) {
+        this->keys[this->depth - 1] = this->handler->map_key(this->token, length);
+        this->state = S_COLON;
+    } else {
+        this->handler->on_value(JsonStreamPath(this->keys, this->depth), JSON_STREAM_STRING, this->token, length);
+        this->end_value();
+    }
+}
+
+bool JsonStreamParser::emit_literal() {
+    this->token[this->token_length] = '\0';
+    JsonStreamValue type;
+    if (strcmp(this->token, "true") == 0) {
+        type = JSON_STREAM_TRUE;
+    } else if (strcmp(this->token, "false") == 0) {
+        type = JSON_STREAM_FALSE;
+    } else if (strcmp(this->token, "null") == 0) {
+        type = JSON_STREAM_NULL;
+    } else if ((this->token[0] >= '0' && this->token[0] <= '9') || this->token[0] == '-') {
+        type = JSON_STREAM_NUMBER;
+    } else {
+        return false;
+    }
+    this->handler->on_value(JsonStreamPath(this->keys, this->depth), type, this->token, this->token_length);
+    this->end_value();
+    return true;
+}
+
+bool JsonStreamParser::process(char c) {
+    switch (this->state) {
+        case S_STRING:
+            if (c == '"') {
+                this->emit_string();
+            } else if (c == '\\') {
+                this->state = S_STRING_ESCAPE;
+            } else {
+                this->append(c);
+            }
+            return true;
+        case S_STRING_ESCAPE:
+            this->state = S_STRING;
+            switch (c) {
+                case 'n': this->append('\n'); break;
+                case 't': this->append('\t'); break;
+                case 'r': this->append('\r'); break;
+                case 'b': this->append('\b'); break;
+                case 'f': this->append('\f'); break;
+                case 'u':
+                    this->unicode = 0;
+                    this->unicode_digits = 0;
+                    this->state = S_STRING_UNICODE;
+                    break;
+                default: this->append(c); break;
+            }
+            return true;
+        case S_STRING_UNICODE: {
+            int value = hex_value(c);
+            if (value < 0) return false;
+            this->unicode = (this->unicode << 4) | value;
+            if (++this->unicode_digits == 4) {
+                this->state = S_STRING;
+                if (this->unicode >= 0xD800 && this->unicode <= 0xDBFF) {
+                    this->high_surrogate = this->unicode;
+                } else if (this->unicode >= 0xDC00 && this->unicode <= 0xDFFF && this->high_surrogate) {
+                    this->append_code_point(0x10000 + ((this->high_surrogate - 0xD800) << 10) + (this->unicode - 0xDC00));
+                    this->high_surrogate = 0;
+                } else {
+                    this->append_code_point(this->unicode);
+                    this->high_surrogate = 0;
+                }
+            }
+            return true;
+        }
+        case S_LITERAL:
+            if (is_literal_char(c)) {
+                if (this->token_length >= JSON_STREAM_MAX_LITERAL) return false;
+                this->token[this->token_length++] = c;
+                return true;
+            }
+            if (!this->emit_literal()) return false;
+            // The delimiter belongs to the next token
+            return this->state == S_DONE ? is_whitespace(c) : this->process(c);
+        default:
+            break;
+    }
+
+    if (is_whitespace(c)) {
+        return true;
+    }
+
+    switch (this->state) {
+        case S_ARRAY_FIRST:
+            if (c == ']') return this->end_container(true);
+            // fall through
+        case S_VALUE:
+            if (c == '{') return this->begin_container(false);
+            if (c == '[') return this->begin_container(true);
+            this->token_length = 0;
+            if (c == '"') {
+                this->is_key = false;
+                this->high_surrogate = 0;
+                this->state = S_STRING;
+                return true;
+            }
+            if (is_literal_char(c)) {
+                this->token[this->token_length++] = c;
+                this->state = S_LITERAL;
+                return true;
+            }
+            return false;
+        case S_OBJECT_FIRST:
+            if (c == '}') return this->end_container(false);
+            // fall through
+        case S_OBJECT_KEY:
+            if (c != '"') return false;
+            this->token_length = 0;
+            this->is_key = true;
+            this->high_surrogate = 0;
+            this->state = S_STRING;
+            return true;
+        case S_COLON:
+            if (c != ':') return false;
+            this->state = S_VALUE;
+            return true;
+        case S_AFTER_VALUE:
+            if (c == ',') {
+                this->state = this->is_array[this->depth - 1] ? S_VALUE : S_OBJECT_KEY;
+                return true;
+            }
+            if (c == '}') return this->end_container(false);
+            if (c == ']') return this->end_container(true);
+            return false;
+        case S_DONE:
+            // Only trailing whitespace is allowed
+            return false;
+        default:
+            return false;
+    }
+}
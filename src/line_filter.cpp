@@ -0,0 +1,124 @@
+#include <algorithm>
+#include <strings.h>
+
+#include "line_filter.h"
+
+static bool is_pattern(const String& line) {
+    return line.indexOf('*') != -1 || line.indexOf('?') != -1;
+}
+
+bool LineFilter::compile(const String& filter) {
+    if (filter == this->source) {
+        return false;
+    }
+    this->source = filter;
+    this->lines.clear();
+    this->rules.clear();
+    int pos = 0;
+    while (pos <= (int)filter.length()) {
+        int end = filter.indexOf(',', pos);
+        if (end == -1) {
+            end = filter.length();
+        }
+        String entry = filter.substring(pos, end);
+        pos = end + 1;
+        entry.trim();
+        if (!entry.length()) {
+            continue;
+        }
+        LineFilterRule rule;
+        int separator = entry.indexOf(':');
+        if (separator == -1) {
+            rule.line = entry;
+        } else {
+            rule.line = entry.substring(0, separator);
+            rule.direction = entry.substring(separator + 1);
+            rule.line.trim();
+            rule.direction.trim();
+        }
+        if (rule.direction.length() || is_pattern(rule.line)) {
+            this->rules.push_back(rule);
+        } else {
+            this->lines.push_back(rule.line);
+        }
+    }
+    std::sort(
+        this->lines.begin(), this->lines.end(),
+        [](const String& a, const String& b) {
+            return strcmp(a.c_str(), b.c_str()) < 0;
+        }
+    );
+    this->lines.erase(std::unique(this->lines.begin(), this->lines.end()), this->lines.end());
+    Serial.printf("Compiled line filter \"%s\": %d lines, %d rules.\n", filter.c_str(), this->lines.size(), this->rules.size());
+    return true;
+}
+
+bool LineFilter::is_empty() const {
+    return this->lines.empty() && this->rules.empty();
+}
+
+const String& LineFilter::get_source() const {
+    return this->source;
+}
+
+bool LineFilter::match_pattern(const char* pattern, const char* text) {
+    // Iterative glob matching, backtracks only to the last '*'
+    const char* star = nullptr;
+    const char* resume = nullptr;
+    while (*text) {
+        if (*pattern == '?' || *pattern == *text) {
+            pattern++;
+            text++;
+        } else if (*pattern == '*') {
+            star = pattern++;
+            resume = text;
+        } else if (star) {
+            pattern = star + 1;
+            text = ++resume;
+        } else {
+            return false;
+        }
+    }
+    while (*pattern == '*') {
+        pattern++;
+    }
+    return *pattern == '\0';
+}
+
+bool LineFilter::match_direction(const String& direction, const char* towards) {
+    return direction.length() == 0 || strncasecmp(towards, direction.c_str(), direction.length()) == 0;
+}
+
+bool LineFilter::has_line(const char* line) const {
+    auto it = std::lower_bound(
+        this->lines.begin(), this->lines.end(), line,
+        [](const String& a, const char* b) {
+            return strcmp(a.c_str(), b) < 0;
+        }
+    );
+    return it != this->lines.end() && strcmp(it->c_str(), line) == 0;
+}
+
+bool LineFilter::matches_line(const char* line) const {
+    if (this->is_empty() || this->has_line(line)) {
+        return true;
+    }
+    for (const auto& rule : this->rules) {
+        if (match_pattern(rule.line.c_str(), line)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool LineFilter::matches(const char* line, const char* towards) const {
+    if (this->is_empty() || this->has_line(line)) {
+        return true;
+    }
+    for (const auto& rule : this->rules) {
+        if (match_pattern(rule.line.c_str(), line) && match_direction(rule.direction, towards)) {
+            return true;
+        }
+    }
+    return false;
+}
@@ -4,6 +4,7 @@
 #include <limits>
 #include <WiFiManager.h>  // by tzapu 2.0.16
 
+#include "alloc_counter.h"
 #include "colors.h"
 #include "config.h"
 #include "oebb.h"
@@ -25,17 +26,26 @@ void action_dim();
 void action_eco_mode(unsigned long time_pressed);
 void action_reset(unsigned long time_pressed);
 void action_switch_layout();
+void action_rbl_changed();
 void action_reconfigure();
 
 void activate_eco_mode();
 void deactivate_eco_mode();
 
+struct CoalesceStats {
+    uint32_t merges = 0;
+    uint32_t notifications = 0;
+    uint32_t folded = 0;     // Notifications that did not cause a merge of their own
+    uint32_t max_batch = 0;
+    uint32_t unchanged = 0;  // Merges skipped because no snapshot version changed
+};
+
 /* Global Variables */
 ButtonTaskConfig button_1_cfg;
 ButtonTaskConfig button_2_cfg;
 
-WLDeparture wl_departure = WLDeparture();
-OEBBDeparture oebb_departure = OEBBDeparture();
+WLDeparture wl_departure;
+OEBBDeparture oebb_departure;
 
 /* Task Functions */
 
@@ -44,52 +54,76 @@ void task_data_coordinator(void* pvParameters) {
     Configuration& config = Configuration::getInstance();
     PowerManager& pm = PowerManager::getInstance();
     static std::vector<Monitor> combined_data;
-    static std::vector<Monitor> wl_data;
-    static std::vector<Monitor> oebb_data;
+    // Shared with the sources, only the merge into combined_data copies the monitors
+    static SourceSnapshot wl_data;
+    static SourceSnapshot oebb_data;
     static uint32_t no_data_counter = 0;
-
-    combined_data.reserve(32);
-    wl_data.reserve(16);
-    oebb_data.reserve(16);
+    static CoalesceStats coalesce_stats;
 
     while (true) {
-        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
-        // Notification of new data received -> clear old data
-        combined_data.clear();
-
-        // Fetch the latest data, only if RBL/EVA are configured
+        uint32_t notifications = ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        // Updates of the sources often arrive together, wait briefly so they are merged once
+        vTaskDelay(pdMS_TO_TICKS(DATA_COALESCE_WINDOW));
+        notifications += ulTaskNotifyTake(pdTRUE, 0);
+        coalesce_stats.merges++;
+        coalesce_stats.notifications += notifications;
+        coalesce_stats.folded += notifications - 1;
+        coalesce_stats.max_batch = std::max(coalesce_stats.max_batch, notifications);
+        // Fetch the latest snapshots, only if RBL/EVA are configured
+        SourceSnapshot wl_latest;
+        SourceSnapshot oebb_latest;
         if(config.get_rbl().length()) {
-            wl_departure.get_latest_snapshot(wl_data);
-            combined_data.insert(combined_data.end(), wl_data.begin(), wl_data.end());
+            wl_departure.get_latest_snapshot(wl_latest);
         }
         if(config.get_eva().length()) {
-            oebb_departure.get_latest_snapshot(oebb_data);
-            combined_data.insert(combined_data.end(), oebb_data.begin(), oebb_data.end());
+            oebb_departure.get_latest_snapshot(oebb_latest);
+        }
+        if (wl_latest.version == wl_data.version && oebb_latest.version == oebb_data.version) {
+            coalesce_stats.unchanged++;
+            Serial.printf("[Master] No source changed, merge skipped (%d skipped).\n", coalesce_stats.unchanged);
+            continue;
+        }
+        wl_data = wl_latest;
+        oebb_data = oebb_latest;
+
+        // Notification of new data received -> rebuild from both snapshots
+        combined_data.clear();
+        combined_data.reserve(
+            (wl_data.monitors ? wl_data.monitors->size() : 0) + (oebb_data.monitors ? oebb_data.monitors->size() : 0)
+        );
+        if (wl_data.monitors) {
+            combined_data.insert(combined_data.end(), wl_data.monitors->begin(), wl_data.monitors->end());
+        }
+        if (oebb_data.monitors) {
+            combined_data.insert(combined_data.end(), oebb_data.monitors->begin(), oebb_data.monitors->end());
         }
+        const size_t monitor_count = combined_data.size();
         
-        if (combined_data.size() > 0) {
-            if(traffic_manager.acquire() == pdTRUE){
-                if (no_data_counter){
-                    if(no_data_counter >= 3 && !pm.is_eco_active()){
-                        pm.get_tft().fillScreen(COLOR_BG);
-                        pm.backlight_on(config.get_brightness());
-                    }
-                    no_data_counter = 0;
+        if (monitor_count > 0) {
+            if (no_data_counter){
+                if(no_data_counter >= 3 && !pm.is_eco_active() && pm.screen_acquire() == pdTRUE){
+                    pm.get_tft().fillScreen(COLOR_BG);
+                    pm.backlight_on(config.get_brightness());
+                    pm.screen_release();
                 }
-                traffic_manager.update(combined_data);
-                traffic_manager.release();
+                no_data_counter = 0;
             }
-            Serial.printf("[Master] Combined Update: %d monitors total.\n", combined_data.size());
+            // Handed over by pointer, the running frame is not waited for
+            traffic_manager.update(std::move(combined_data));
+            Serial.printf(
+                "[Master] Combined Update: %d monitors total, %d notifications (%d of %d folded, max %d).\n",
+                monitor_count, notifications, coalesce_stats.folded, coalesce_stats.notifications, coalesce_stats.max_batch
+            );
         } else {
             no_data_counter += 1;
             if(no_data_counter == 3){
-                if(traffic_manager.acquire() == pdTRUE){
+                traffic_manager.update(std::move(combined_data));
+                if(pm.screen_acquire() == pdTRUE){
                     pm.get_tft().fillScreen(COLOR_BG);
-                    traffic_manager.update(combined_data);
-                    traffic_manager.release();
-                    if (!pm.is_eco_active()){
-                        pm.backlight_on(15.0);
-                    }
+                    pm.screen_release();
+                }
+                if (!pm.is_eco_active()){
+                    pm.backlight_on(15.0);
                 }
             }
         }
@@ -100,16 +134,15 @@ void task_screen_update(void* pvParameters) {
     PowerManager& instance = PowerManager::getInstance();
     TraficManager& traffic_manager = TraficManager::getInstance();
     Screen& screen = Screen::getInstance();
+    // The render stats report the allocations of this task
+    alloc_counter_watch(xTaskGetCurrentTaskHandle());
     while (true) {
         if(!instance.is_portal_active()) {
             //Only draw if the config protal is not active
-            if(traffic_manager.acquire() == pdTRUE){
-                if(screen.acquire() == pdTRUE){
-                    // TrafficManager handles the mutex internally
-                    traffic_manager.updateScreen();
-                    screen.release();
-                }
-                traffic_manager.release();
+            if(screen.acquire() == pdTRUE){
+                // New data is adopted at the start of the frame, without a lock
+                traffic_manager.updateScreen();
+                screen.release();
             }
         }
         vTaskDelay(pdMS_TO_TICKS(SCREEN_UPDATE_DELAY));
@@ -146,10 +179,11 @@ void action_dim(){
 }
 
 void action_eco_mode(unsigned long time_pressed){
-    TraficManager& traffic_manager = TraficManager::getInstance();
+    PowerManager& pm = PowerManager::getInstance();
     Configuration& config = Configuration::getInstance();
     if (time_pressed >= 1000) {
-        if(traffic_manager.acquire() == pdTRUE){
+        // The screen task must not be suspended in the middle of a frame
+        if(pm.screen_acquire() == pdTRUE){
             switch (config.get_eco_mode_state())
             {
                 case ECO_OFF:
@@ -164,7 +198,7 @@ void action_eco_mode(unsigned long time_pressed){
                 default:
                     break;
             }
-            traffic_manager.release();
+            pm.screen_release();
         }
     }
 }
@@ -179,6 +213,11 @@ void action_switch_layout(){
     }
 }
 
+void action_rbl_changed(){
+    // Called by the config portal, the new stops are shown without waiting for the scheduled poll
+    wl_departure.request_poll();
+}
+
 void action_reconfigure(){
     PowerManager& pm = PowerManager::getInstance();
     if(!pm.is_portal_active()){
@@ -209,6 +248,10 @@ void deactivate_eco_mode() {
     Configuration& config = Configuration::getInstance();
     pm.eco_mode_off();
     config.set_eco_mode_state(ECO_OFF);
+    if (config.get_eco_mode() == ECO_HEAVY) {
+        // WiFi is back, the scheduled poll might be minutes away
+        wl_departure.request_poll();
+    }
     if (config.get_eco_mode() == ECO_HEAVY && !oebb_departure.is_connected()){
         vTaskDelay(pdMS_TO_TICKS(1000));
         oebb_departure.setup();
@@ -303,6 +346,16 @@ void setup() {
     if (config.get_eco_mode_state() != ECO_OFF) {
         pm.eco_mode_on();
     }
+    // The coordinator must be notified of the first publish, so it is created before the sources start
+    TaskHandle_t data_coordinator;
+    status = xTaskCreatePinnedToCore(task_data_coordinator, "task_data_update", 1024 * 16, NULL, 2, &data_coordinator, APP_CPU_NUM);
+    if (status == pdPASS) {
+        wl_departure.set_notification(data_coordinator);
+        oebb_departure.set_notification(data_coordinator);
+    } else {
+        Serial.printf("Could not create data coordinator task: %d\n", status);
+    }
+
     // Setup is finished, setup WienerLinien Timer
     wl_departure.setup();
     // Requires Internet to fetch station ID
@@ -332,15 +385,6 @@ void setup() {
         Serial.printf("Could not create button 1 task: %d\n", status);
     }
     
-    // Create tasks for data updating and screen updating
-    TaskHandle_t data_coordinator;
-    status = xTaskCreatePinnedToCore(task_data_coordinator, "task_data_update", 1024 * 16, NULL, 2, &data_coordinator, APP_CPU_NUM);
-    if (status == pdPASS) {
-        wl_departure.set_notification(data_coordinator);
-        oebb_departure.set_notification(data_coordinator);
-    } else {
-        Serial.printf("Could not create data coordinator task: %d\n", status);
-    }
     pm.draw();
 }
 
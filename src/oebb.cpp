@@ -11,13 +11,11 @@ void OEBBDeparture::handle_deserialisation_error(DeserializationError& error) {
             Serial.printf("JSON parsing error: %S\n", error.c_str());
             break;
         case DeserializationError::Code::NoMemory:
-            // Not enough memory to parse - restarting
-            Serial.println(F("Not enough memory to deserialise the json from OEBB API"));
-            delay(ERROR_RESET_DELAY);
-            if(this->is_connected()){
-                this->web_socket.disconnect();
-            }
-            ESP.restart();
+            // The documents live in the PSRAM arenas, so this is not caused by heap fragmentation
+            Serial.printf(
+                "Arena too small to deserialise the json from OEBB API (%d/%d bytes)\n",
+                this->station_arena.get_high_water_mark(), this->station_arena.get_capacity()
+            );
             break;
             
         default:
@@ -30,91 +28,242 @@ void OEBBDeparture::task_traffic(void *pvParameters) {
     OEBBDeparture* instance = (OEBBDeparture*)pvParameters;
     NetworkManager& network = NetworkManager::getInstance();
     while(true) {
-        if (instance->web_socket.isConnected()) {
-            // If connected, loop is lightweight (just keep-alive)
-            instance->web_socket.loop();
-        } else if (network.acquire() == pdTRUE) {
-            // If disconnected, loop() implies a heavy Reconnect Handshake!
-            instance->web_socket.loop();
-            network.release();
+        // All sessions share this task, each loop() call only handles what is pending
+        for (size_t i = 0; i < instance->station_count; i++) {
+            OEBBStation& station = instance->stations[i];
+            instance->refresh_station(i);
+            if (station.plc.length() == 0) {
+                // The station could not be resolved during setup
+                if (instance->is_station_refresh_due(station)) {
+                    instance->request_station_refresh(station);
+                }
+            } else if (station.web_socket.isConnected()) {
+                // If connected, loop is lightweight (just keep-alive)
+                station.web_socket.loop();
+                OEBBConnectionStats& stats = station.connection_stats;
+                if (stats.consecutive_failures && millis() - stats.connected_since >= OEBB_STABLE_CONNECTION) {
+                    // Only a connection that lasts resets the backoff
+                    instance->reset_consecutive_failures(station);
+                }
+                if (instance->is_station_refresh_due(station)) {
+                    instance->request_station_refresh(station);
+                }
+            } else if (instance->is_connect_due(station) && network.acquire() == pdTRUE) {
+                // If disconnected, loop() implies a heavy Reconnect Handshake!
+                station.web_socket.loop();
+                network.release();
+            }
         }
+        instance->send_acks();
         vTaskDelay(pdMS_TO_TICKS(20));
     }
 }
 
-void OEBBDeparture::event(WStype_t type, uint8_t * payload, size_t length) {
-    static JsonDocument filter;
-    if(filter["jsonrpc"].isNull()){
-        filter["jsonrpc"] = true;
-        filter["method"] = true;
-        filter["id"] = true;
+void OEBBDeparture::task_parse(void *pvParameters) {
+    OEBBDeparture* instance = (OEBBDeparture*)pvParameters;
+    while(true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        size_t length;
+        uint8_t tag;
+        const char* frame;
+        while((frame = instance->frame_ring.front(length, tag)) != nullptr) {
+            instance->process_frame(tag, frame, length);
+            instance->frame_ring.pop();
+        }
+    }
+}
 
-        JsonObject filter_data = filter["params"]["data"].to<JsonObject>();
-        filter_data["specialNotices"] = true;
+void OEBBDeparture::task_refresh(void *pvParameters) {
+    OEBBDeparture* instance = (OEBBDeparture*)pvParameters;
+    while(true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        for (size_t i = 0; i < OEBB_MAX_STATIONS; i++) {
+            String eva;
+            if (xSemaphoreTake(instance->internal_mutex, portMAX_DELAY) == pdTRUE) {
+                OEBBStation& station = instance->stations[i];
+                if (i < instance->station_count && station.is_refresh_requested) {
+                    station.is_refresh_requested = false;
+                    eva = station.eva;
+                }
+                xSemaphoreGive(instance->internal_mutex);
+            }
+            if (eva.length() == 0) {
+                continue;
+            }
+            // A failed refresh keeps the cached station, it is retried after STATION_REFRESH_RETRY_DELAY
+            StationInfo info;
+            if (!instance->fetch_station(eva, info, false)) {
+                continue;
+            }
+            if (xSemaphoreTake(instance->internal_mutex, portMAX_DELAY) == pdTRUE) {
+                OEBBStation& station = instance->stations[i];
+                // The stations may have been changed during the request
+                if (i < instance->station_count && station.eva == eva) {
+                    station.refreshed_info = info;
+                    station.is_refreshed = true;
+                }
+                xSemaphoreGive(instance->internal_mutex);
+            }
+        }
+    }
+}
 
-        JsonObject filter_departures = filter_data["departures"].add<JsonObject>();
-        filter_departures["destination"]["default"] = true;
-        filter_departures["expected"] = true;
-        filter_departures["flags"] = true;
-        filter_departures["line"] = true;
-        // filter_departures["prioritizedVias"] = true;
-        // filter_departures["remarks"] = true;
-        filter_departures["scheduled"] = true;
-        filter_departures["track"] = true;
-        // filter_departures["via"] = true;
+void OEBBDeparture::send_acks() {
+    OEBBAck ack;
+    while(xQueueReceive(this->ack_queue, &ack, 0) == pdTRUE) {
+        if (ack.station < this->station_count) {
+            this->stations[ack.station].web_socket.sendTXT(ack.text);
+        }
     }
-    NetworkManager& network = NetworkManager::getInstance();
+}
+
+void OEBBDeparture::event(size_t idx, WStype_t type, uint8_t * payload, size_t length) {
+    const char* eva = this->stations[idx].eva.c_str();
     if(type == WStype_TEXT){
-        if(network.acquire() == pdTRUE){
-            JsonDocument data;
-            DeserializationError error = deserializeJson(
-                data, payload, DeserializationOption::Filter(filter), DeserializationOption::NestingLimit(10)
-            );
-            if (error) {
-                handle_deserialisation_error(error);
-            } else if (data["method"].as<String>() == "update") {
-                // Send response to server
-                JsonDocument response;
-                response["jsonrpc"] = data["jsonrpc"];
-                response["result"] = JsonVariant();
-                response["id"] = data["id"];
-                response.shrinkToFit(); // Frees unused heap bytes before serialization
-                String tmp;
-                serializeJson(response, tmp);
-                this->web_socket.sendTXT(tmp);
-                if (xSemaphoreTake(this->internal_mutex, portMAX_DELAY) == pdTRUE) {
-                    this->monitors.clear();
-                    this->fill_monitors_from_json(data);
-                    this->monitors.shrink_to_fit();
-                    Serial.printf("Merged into %d monitors.\n", this->monitors.size());
-                    xSemaphoreGive(this->internal_mutex);
-                    // Notify data coordinator of data update
-                    xTaskNotifyGive(this->notification);
-                }
-            }
-            network.release();
+        // Only copied here, the websocket task must not wait for the parser
+        uint8_t tag = (this->station_generation.load() << OEBB_FRAME_TAG_INDEX_BITS) | idx;
+        if(this->frame_ring.push(payload, length, tag) && this->handle_task_parse != nullptr){
+            xTaskNotifyGive(this->handle_task_parse);
         }
     } else if(type == WStype_CONNECTED){
-        Serial.println(F("[WS] Connected. Protocol Switched."));
+        Serial.printf("[WS %s] Connected. Protocol Switched.\n", eva);
+        this->on_connected(this->stations[idx]);
     } else if(type == WStype_DISCONNECTED){
         if(payload){
-            Serial.printf("[WS] Disconnected: %s\n", payload);
+            Serial.printf("[WS %s] Disconnected: %s\n", eva, payload);
         } else {
-            Serial.println(F("[WS] Disconnected."));
+            Serial.printf("[WS %s] Disconnected.\n", eva);
         }
+        this->on_disconnected(this->stations[idx], payload ? reinterpret_cast<const char*>(payload) : "disconnected");
     } else if(type == WStype_ERROR){
-        Serial.printf("[WS] Error: %s\n", payload);
+        Serial.printf("[WS %s] Error: %s\n", eva, payload);
+        this->set_last_error(this->stations[idx], payload ? reinterpret_cast<const char*>(payload) : "error");
+    }
+}
+
+bool OEBBDeparture::is_current_frame(uint8_t tag) const {
+    size_t idx = tag & ((1 << OEBB_FRAME_TAG_INDEX_BITS) - 1);
+    uint8_t generation = tag >> OEBB_FRAME_TAG_INDEX_BITS;
+    uint8_t current = this->station_generation.load() & (0xFF >> OEBB_FRAME_TAG_INDEX_BITS);
+    return generation == current && idx < this->station_count;
+}
+
+void OEBBDeparture::process_frame(uint8_t tag, const char* frame, size_t length) {
+    Configuration& config = Configuration::getInstance();
+    this->line_filter.compile(config.get_eva_filter());
+    size_t idx = tag & ((1 << OEBB_FRAME_TAG_INDEX_BITS) - 1);
+    String station_name;
+    bool is_current = false;
+    if (xSemaphoreTake(this->internal_mutex, portMAX_DELAY) == pdTRUE) {
+        is_current = this->is_current_frame(tag);
+        if (is_current) {
+            station_name = this->stations[idx].name;
+        }
+        xSemaphoreGive(this->internal_mutex);
+    }
+    if (!is_current) {
+        // Queued before the stations were changed, it belongs to a station that is gone
+        return;
+    }
+    // The frame is parsed straight out of its slot, no JsonDocument is built
+    this->monitor_parser.begin(station_name, this->line_filter);
+    this->stream_parser.reset(&this->monitor_parser);
+    this->stream_parser.feed(reinterpret_cast<const uint8_t*>(frame), length);
+    if (!this->stream_parser.is_done()) {
+        Serial.printf("JSON parsing error after %d of %d bytes\n", this->stream_parser.get_bytes_fed(), length);
+        return;
+    }
+    if (!this->monitor_parser.is_update()) {
+        return;
+    }
+    // Queue the response to the server
+    OEBBAck ack;
+    ack.station = idx;
+    if (this->monitor_parser.format_ack(ack.text, sizeof(ack.text))) {
+        xQueueSend(this->ack_queue, &ack, 0);
+    } else {
+        Serial.println(F("[WS] Could not acknowledge the update."));
+    }
+    bool is_changed = false;
+    if (xSemaphoreTake(this->internal_mutex, portMAX_DELAY) == pdTRUE) {
+        // The stations may have been changed while the frame was parsed
+        if (this->is_current_frame(tag)) {
+            OEBBStation& station = this->stations[idx];
+            if (this->is_content_changed(station.content_hash, this->monitor_parser.get_content_hash())) {
+                station.monitors.swap(this->pending_monitors);
+                is_changed = true;
+                Serial.printf("Merged into %d monitors of %s.\n", station.monitors.size(), station_name.c_str());
+            } else {
+                // An empty board is published with every frame, the data coordinator counts them to clear the screen
+                is_changed = this->is_empty();
+            }
+        }
+        xSemaphoreGive(this->internal_mutex);
+    }
+    if (is_changed) {
+        this->publish_stations();
     }
 }
 
-void OEBBDeparture::get_station() {
+void OEBBDeparture::set_stations(const String& eva) {
+    if (xSemaphoreTake(this->internal_mutex, portMAX_DELAY) != pdTRUE) {
+        return;
+    }
+    this->station_count = 0;
+    this->station_generation++;
+    for_each_entry(eva, [this](const String& entry) {
+        if (this->station_count == OEBB_MAX_STATIONS) {
+            Serial.printf("Only %d OEBB stations are supported, ignoring %s.\n", OEBB_MAX_STATIONS, entry.c_str());
+            return;
+        }
+        OEBBStation& station = this->stations[this->station_count++];
+        if (station.eva != entry) {
+            station.eva = entry;
+            station.name.clear();
+            station.plc.clear();
+            station.updated = 0;
+        }
+        station.refresh_attempt = 0;
+        station.is_refresh_requested = false;
+        station.is_refreshed = false;
+        station.content_hash = 0;
+        station.monitors.clear();
+    });
+    xSemaphoreGive(this->internal_mutex);
+    // Departures of removed stations must not stay on the screen
+    this->publish_stations();
+}
+
+bool OEBBDeparture::is_empty() const {
+    for (size_t i = 0; i < this->station_count; i++) {
+        if (!this->stations[i].monitors.empty()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void OEBBDeparture::publish_stations() {
+    std::shared_ptr<std::vector<Monitor>> monitors = this->acquire_buffer();
+    if (xSemaphoreTake(this->internal_mutex, portMAX_DELAY) == pdTRUE) {
+        // The stops of different stations never collide
+        for (size_t i = 0; i < this->station_count; i++) {
+            const std::vector<Monitor>& station_monitors = this->stations[i].monitors;
+            monitors->insert(monitors->end(), station_monitors.begin(), station_monitors.end());
+        }
+        xSemaphoreGive(this->internal_mutex);
+    }
+    this->publish(monitors);
+}
+
+bool OEBBDeparture::fetch_station(const String& eva, StationInfo& info, bool is_restart_allowed) {
     NetworkManager& network = NetworkManager::getInstance();
     Configuration& config = Configuration::getInstance();
-    const String& eva = config.get_eva();
     int eva_length = eva.length();
     char url[60] = URL_OEBB;
     const int pos = strlen(url);
-    if(eva_length){
+    bool is_updated = false;
+    if(eva_length && pos + eva_length < (int)sizeof(url)){
         if (network.acquire() == pdTRUE) {
             HTTPClient https;
             for(int i = pos; i<pos+eva_length; i++){
@@ -129,167 +278,511 @@ void OEBBDeparture::get_station() {
             int http_code = https.GET();
 
             if (http_code == HTTP_CODE_OK) {
-                JsonDocument root;
-                DeserializationError error = deserializeJson(root, https.getStream());
-                if (error) {
-                    handle_deserialisation_error(error);
-                } else {
-                    if (!root["name"].isNull()){
-                        this->station_name = root["name"].as<String>();
-                    }
-                    if (!root["plc"].isNull()){
-                        this->station_id = root["plc"].as<String>();
+                {
+                    JsonDocument root(&this->station_arena);
+                    DeserializationError error = deserializeJson(root, https.getStream());
+                    if (error) {
+                        handle_deserialisation_error(error);
+                    } else {
+                        if (!root["name"].isNull()){
+                            info.name = root["name"].as<String>();
+                        }
+                        if (!root["plc"].isNull()){
+                            info.plc = root["plc"].as<String>();
+                        }
                     }
                 }
-                Serial.printf("Station %s: %s\n", this->station_name, this->station_id);                
+                this->station_arena.print_high_water_mark();
+                this->station_arena.reset();
+                if (info.plc.length()) {
+                    time_t now = time(nullptr);
+                    info.updated = now >= MIN_VALID_EPOCH ? now : 0;
+                    config.set_station(eva, info);
+                    is_updated = true;
+                }
+                Serial.printf("Station %s: %s\n", info.name.c_str(), info.plc.c_str());
             } else {
                 Serial.printf("HTTP Code: %d\n", http_code);
-                // Currently the software causes a lot of heap fragmentation
-                // This causes the SSL connection to fail, because it needs a lot of continuous RAM 
-                // To fix this the original software defined a reboot interval
-                // If SSL fails, the connection will be refused
-                if (http_code == HTTPC_ERROR_CONNECTION_REFUSED){
-                    // We restart to reset the heap
-                    ESP.restart();
+                if (is_restart_allowed) {
+                    this->restart_if_refused(http_code);
                 }
             }
             https.end();
             network.release();
         }
-    } else {
-        this->station_name.clear();
-        this->station_id.clear();
+    }
+    return is_updated;
+}
+
+bool OEBBDeparture::get_station(OEBBStation& station) {
+    StationInfo info;
+    if (!this->fetch_station(station.eva, info, true)) {
+        return false;
+    }
+    this->set_station(station, info);
+    return true;
+}
+
+void OEBBDeparture::set_station(OEBBStation& station, const StationInfo& info) {
+    // The name is read by the parse task
+    if (xSemaphoreTake(this->internal_mutex, portMAX_DELAY) == pdTRUE) {
+        station.name = info.name;
+        station.plc = info.plc;
+        station.updated = info.updated;
+        xSemaphoreGive(this->internal_mutex);
     }
 }
 
-void OEBBDeparture::fill_monitors_from_json(JsonDocument& root) {
-    if (root["params"].isNull()) return;
+bool OEBBDeparture::load_station(OEBBStation& station) {
     Configuration& config = Configuration::getInstance();
-    struct tm today;
-    if(!getLocalTime(&today)){
-        Serial.print("Couldn't get the correct time.");
+    StationInfo info;
+    if (config.get_station(station.eva, info)) {
+        Serial.printf("Cached station %s: %s\n", info.name.c_str(), info.plc.c_str());
+        this->set_station(station, info);
+        return true;
     }
-    time_t now = mktime(&today);
-    const JsonObject data = root["params"]["data"];
-    const JsonArray departures = data["departures"];
-    const JsonArray notices = data["specialNotices"];
-    String eva_filter = config.get_eva_filter();
-    std::vector<String> filters;
-    if(eva_filter.length()){
-        int pos = 0, end = eva_filter.indexOf(",", pos);
-        if(end == -1){
-            filters.push_back(eva_filter);
-        } else {
-            do {
-                filters.push_back(eva_filter.substring(pos, end));
-                pos = end+1;
-                end = eva_filter.indexOf(",", pos);
-            } while(end != -1);
-            //Add the last elment
-            filters.push_back(eva_filter.substring(pos));
+    // Nothing cached yet, the station has to be known before connecting
+    return this->get_station(station);
+}
+
+bool OEBBDeparture::is_station_refresh_due(const OEBBStation& station) {
+    if (station.refresh_attempt != 0 && millis() - station.refresh_attempt < STATION_REFRESH_RETRY_DELAY) {
+        return false;
+    }
+    if (station.plc.length() == 0) {
+        return true;
+    }
+    time_t now = time(nullptr);
+    // The age is unknown until the clock is synchronised
+    if (now < MIN_VALID_EPOCH) {
+        return false;
+    }
+    return station.updated == 0 || now - station.updated > STATION_CACHE_TTL;
+}
+
+void OEBBDeparture::request_station_refresh(OEBBStation& station) {
+    station.refresh_attempt = millis();
+    if (this->handle_task_refresh == nullptr) {
+        return;
+    }
+    if (xSemaphoreTake(this->internal_mutex, portMAX_DELAY) == pdTRUE) {
+        station.is_refresh_requested = true;
+        xSemaphoreGive(this->internal_mutex);
+    }
+    xTaskNotifyGive(this->handle_task_refresh);
+}
+
+void OEBBDeparture::refresh_station(size_t idx) {
+    OEBBStation& station = this->stations[idx];
+    StationInfo info;
+    bool is_refreshed = false;
+    if (xSemaphoreTake(this->internal_mutex, portMAX_DELAY) == pdTRUE) {
+        if (station.is_refreshed) {
+            info = station.refreshed_info;
+            station.is_refreshed = false;
+            is_refreshed = true;
         }
+        xSemaphoreGive(this->internal_mutex);
+    }
+    if (!is_refreshed) {
+        return;
+    }
+    String previous_plc = station.plc;
+    this->set_station(station, info);
+    if (station.plc != previous_plc) {
+        Serial.printf("Station of EVA %s moved to %s, reconnecting.\n", station.eva.c_str(), station.plc.c_str());
+        if (previous_plc.length()) {
+            station.web_socket.disconnect();
+        }
+        this->connect_socket(idx);
     }
+}
 
-    if (!departures.isNull()) {
-        Serial.printf("Received %d monitor from OEBB API.\n", departures.size());
-        for (const auto& departure : departures) {
-            String line_name = departure["line"].as<String>();
-            bool filter_match = filters.empty();
-            for(String filter : filters){
-                if(filter == line_name) {
-                    filter_match = true;
-                    break;
-                }
-            }
-            if(!filter_match){
-                continue;
-            }
-            const JsonObject dst = departure["destination"];
-            // const JsonObject via = departure["via"];
-            // String via_txt = Screen::ConvertGermanToLatin(via["default"].as<String>());
-            // via_txt.replace("&#8203;", "");
-            String stop = this->station_name + ": Platform " + departure["track"].as<String>();
-            Monitor* monitor_p = findMonitor(this->monitors, line_name, stop);
-            Monitor monitor;
-            monitor.line = line_name;
-            monitor.stop = stop;
-            monitor.towards = Screen::ConvertGermanToLatin(dst["default"].as<String>());
-            monitor.is_barrier_free = false;
-            // Add special notices
-            // struct TrafficInfo traffic_info;
-            // traffic_info.related_lines.push_back(line_name);
-            // traffic_info.description = info;
-            // if (monitor_p) {
-            //     monitor_p->traffic_info = traffic_info;
-            // } else {
-            //     monitor.traffic_info = traffic_info;
-            // }
-                    
-            Vehicle vehicle;
-            time_t scheduled;
-            if(!departure["expected"].isNull()) {
-                scheduled = departure["expected"].as<time_t>();
-            } else {
-                scheduled = departure["scheduled"].as<time_t>();
-            }
-            vehicle.countdown = static_cast<int>(difftime(scheduled, now) / 60);
-            vehicle.line = monitor.line;
-            vehicle.towards = monitor.towards;
-            vehicle.is_barrier_free = monitor.is_barrier_free;
-            vehicle.has_folding_ramp = false;
-            vehicle.is_cancelled = false;
-            vehicle.is_airport = false;
-            JsonArray flags = departure["flags"];
-            for(JsonVariant flag : flags){
-                String f = flag.as<String>();
-                if(f == "CANCELED") {
-                    vehicle.is_cancelled = true;
-                } else if(f == "AIRPORT") {
-                    // ToDo add Airplane symbol to screen
-                    vehicle.is_airport = true;
-                }
+void OEBBDeparture::connect_socket(size_t idx) {
+    OEBBStation& station = this->stations[idx];
+    String loader_url = "/abfahrtankunft/webdisplay/web_client/ws/?stationId=" + station.plc + "&contentType=departure&staticLayout=true&page=1&offset=0&ignoreIncident=false&expandAll=false";
+    station.web_socket.beginSSL("meine.oebb.at", 443, loader_url, "", "");
+    station.web_socket.setExtraHeaders("Origin: https://meine.oebb.at");
+    station.web_socket.onEvent([this, idx](WStype_t type, uint8_t * payload, size_t length) {
+        this->event(idx, type, payload, length);
+    });
+    // The library retries at most once per attempt, the backoff is done by is_connect_due()
+    station.web_socket.setReconnectInterval(OEBB_CONNECT_TIMEOUT);
+    this->set_connection_state(station, OEBB_CONNECTING);
+    station.attempt_start = millis();
+}
+
+bool OEBBDeparture::is_connect_due(OEBBStation& station) {
+    unsigned long now = millis();
+    switch (station.connection_stats.state) {
+        case OEBB_CONNECTING:
+            if (now - station.attempt_start < OEBB_CONNECT_TIMEOUT) {
+                return true;
             }
-            if(vehicle.is_cancelled){
-                continue;
+            this->on_connect_failed(station, "handshake timeout");
+            return false;
+        case OEBB_BACKOFF:
+        case OEBB_CIRCUIT_OPEN:
+            if (now - station.backoff_start < station.backoff_delay) {
+                return false;
             }
-            if (monitor_p) {
-                //Monitor with line name already exists -> different towards
-                monitor_p->vehicles.push_back(vehicle);
-            } else {
-                monitor.vehicles.push_back(vehicle);
+            if (station.connection_stats.state == OEBB_CIRCUIT_OPEN) {
+                Serial.printf("[WS %s] Circuit half-open, trying to connect again.\n", station.eva.c_str());
             }
-            if (!monitor_p) {
-                // New monitor with linename and stop
-                this->monitors.push_back(monitor);
+            this->set_connection_state(station, OEBB_CONNECTING);
+            station.attempt_start = now;
+            return true;
+        case OEBB_CONNECTED:
+            // The connection was lost without an event
+            this->on_disconnected(station, "connection lost");
+            return false;
+        default:
+            return false;
+    }
+}
+
+void OEBBDeparture::on_connected(OEBBStation& station) {
+    unsigned long now = millis();
+    if (xSemaphoreTake(this->internal_mutex, portMAX_DELAY) == pdTRUE) {
+        OEBBConnectionStats& stats = station.connection_stats;
+        stats.last_handshake_ms = now - station.attempt_start;
+        stats.max_handshake_ms = std::max(stats.max_handshake_ms, stats.last_handshake_ms);
+        if (stats.connects > 0) {
+            stats.reconnects++;
+        }
+        stats.connects++;
+        stats.connected_since = now;
+        stats.state = OEBB_CONNECTED;
+        xSemaphoreGive(this->internal_mutex);
+    }
+}
+
+void OEBBDeparture::on_disconnected(OEBBStation& station, const char* reason) {
+    OEBBConnectionStats& stats = station.connection_stats;
+    if (stats.state == OEBB_CONNECTING) {
+        this->on_connect_failed(station, reason);
+        return;
+    }
+    if (stats.state != OEBB_CONNECTED) {
+        return;
+    }
+    unsigned long now = millis();
+    unsigned long uptime = now - stats.connected_since;
+    if (xSemaphoreTake(this->internal_mutex, portMAX_DELAY) == pdTRUE) {
+        stats.uptime_ms += uptime;
+        stats.state = OEBB_BACKOFF;
+        xSemaphoreGive(this->internal_mutex);
+    }
+    if (uptime < OEBB_STABLE_CONNECTION) {
+        // A connection that drops right away counts as failed, so a flapping server backs off as well
+        this->on_connect_failed(station, reason);
+        return;
+    }
+    this->set_last_error(station, reason);
+    this->reset_consecutive_failures(station);
+    // Spread the reconnects of all clients after a server restart
+    station.backoff_start = now;
+    station.backoff_delay = random(0, OEBB_BACKOFF_MIN);
+}
+
+void OEBBDeparture::on_connect_failed(OEBBStation& station, const char* reason) {
+    OEBBConnectionStats& stats = station.connection_stats;
+    this->set_last_error(station, reason);
+    if (xSemaphoreTake(this->internal_mutex, portMAX_DELAY) == pdTRUE) {
+        stats.failed_attempts++;
+        stats.consecutive_failures++;
+        station.backoff_start = millis();
+        if (stats.consecutive_failures >= OEBB_CIRCUIT_BREAKER_FAILURES) {
+            // Stays open until an attempt succeeds, every failed half-open attempt opens it again
+            stats.state = OEBB_CIRCUIT_OPEN;
+            stats.circuit_opens++;
+            station.backoff_delay = OEBB_CIRCUIT_OPEN_DELAY;
+        } else {
+            unsigned long delay = OEBB_BACKOFF_MIN;
+            for (uint32_t i = 1; i < stats.consecutive_failures && delay < OEBB_BACKOFF_MAX; i++) {
+                delay *= 2;
             }
+            delay = std::min<unsigned long>(delay, OEBB_BACKOFF_MAX);
+            stats.state = OEBB_BACKOFF;
+            station.backoff_delay = delay + random(0, delay / 4 + 1);
         }
-        for (auto& m: this->monitors) {
-            // sort vehicles by arriving time
-            std::sort(
-                m.vehicles.begin(), m.vehicles.end(),
-                [](const Vehicle& a, const Vehicle& b) {
-                        return a.countdown < b.countdown;
-                }
-            );
+        xSemaphoreGive(this->internal_mutex);
+    }
+    Serial.printf(
+        "[WS %s] Connection failed (%s), %d in a row, next attempt in %d s%s.\n",
+        station.eva.c_str(), reason, stats.consecutive_failures, station.backoff_delay / 1000,
+        stats.state == OEBB_CIRCUIT_OPEN ? " (circuit open)" : ""
+    );
+}
+
+void OEBBDeparture::set_last_error(OEBBStation& station, const char* error) {
+    if (xSemaphoreTake(this->internal_mutex, portMAX_DELAY) == pdTRUE) {
+        station.connection_stats.errors++;
+        strncpy(station.connection_stats.last_error, error, OEBB_ERROR_MAX_LENGTH - 1);
+        station.connection_stats.last_error[OEBB_ERROR_MAX_LENGTH - 1] = '\0';
+        xSemaphoreGive(this->internal_mutex);
+    }
+}
+
+void OEBBDeparture::set_connection_state(OEBBStation& station, OEBBConnectionState state) {
+    if (xSemaphoreTake(this->internal_mutex, portMAX_DELAY) == pdTRUE) {
+        station.connection_stats.state = state;
+        xSemaphoreGive(this->internal_mutex);
+    }
+}
+
+void OEBBDeparture::reset_consecutive_failures(OEBBStation& station) {
+    if (xSemaphoreTake(this->internal_mutex, portMAX_DELAY) == pdTRUE) {
+        station.connection_stats.consecutive_failures = 0;
+        xSemaphoreGive(this->internal_mutex);
+    }
+}
+
+OEBBMonitorParser::OEBBMonitorParser(std::vector<Monitor>& monitors)
+    : monitors(monitors), filter(nullptr), now(0), content_hash(0), is_update_method(false), is_id_string(false) {
+    this->id[0] = '\0';
+}
+
+void OEBBMonitorParser::begin(const String& station_name, const LineFilter& filter) {
+    this->monitors.clear();
+    this->monitor_index.attach(this->monitors);
+    this->filter = &filter;
+    this->station_name = station_name;
+    this->is_update_method = false;
+    this->is_id_string = false;
+    this->id[0] = '\0';
+    struct tm today;
+    if(!getLocalTime(&today)){
+        Serial.print("Couldn't get the correct time.");
+    }
+    this->now = mktime(&today);
+    // The filter and the station change the result as well
+    this->content_hash = hash(2166136261u, filter.get_source().c_str(), filter.get_source().length());
+    this->content_hash = hash(this->content_hash, station_name.c_str(), station_name.length());
+}
+
+uint32_t OEBBMonitorParser::hash(uint32_t hash, const char* data, size_t length) {
+    // FNV-1a, the terminator separates consecutive fields
+    for (size_t i = 0; i <= length; i++) {
+        hash = (hash ^ static_cast<uint8_t>(i < length ? data[i] : 0)) * 16777619u;
+    }
+    return hash;
+}
+
+uint32_t OEBBMonitorParser::get_content_hash() const {
+    return this->content_hash;
+}
+
+bool OEBBMonitorParser::is_update() const {
+    return this->is_update_method;
+}
+
+size_t OEBBMonitorParser::format_ack(char* buffer, size_t size) const {
+    static const char prefix[] = "{\"jsonrpc\":\"2.0\",\"result\":null,\"id\":";
+    const size_t prefix_length = sizeof(prefix) - 1;
+    const size_t id_length = strlen(this->id);
+    const size_t quotes = this->is_id_string ? 2 : 0;
+    // The id is copied verbatim, so it must not need escaping
+    if (id_length == 0 || strpbrk(this->id, "\"\\") != nullptr || prefix_length + id_length + quotes + 2 > size) {
+        return 0;
+    }
+    char* pos = buffer;
+    memcpy(pos, prefix, prefix_length);
+    pos += prefix_length;
+    if (this->is_id_string) *pos++ = '"';
+    memcpy(pos, this->id, id_length);
+    pos += id_length;
+    if (this->is_id_string) *pos++ = '"';
+    *pos++ = '}';
+    *pos = '\0';
+    return pos - buffer;
+}
+
+uint8_t OEBBMonitorParser::map_key(const char* key, size_t length) {
+    static const struct { const char* name; OEBBKey id; } known_keys[] = {
+        {"method", OEBB_KEY_METHOD},
+        {"id", OEBB_KEY_ID},
+        {"params", OEBB_KEY_PARAMS},
+        {"data", OEBB_KEY_DATA},
+        {"departures", OEBB_KEY_DEPARTURES},
+        {"line", OEBB_KEY_LINE},
+        {"track", OEBB_KEY_TRACK},
+        {"scheduled", OEBB_KEY_SCHEDULED},
+        {"expected", OEBB_KEY_EXPECTED},
+        {"destination", OEBB_KEY_DESTINATION},
+        {"default", OEBB_KEY_DEFAULT},
+        {"flags", OEBB_KEY_FLAGS},
+    };
+    for (const auto& known_key : known_keys) {
+        if (strcmp(known_key.name, key) == 0) {
+            return known_key.id;
+        }
+    }
+    return OEBB_KEY_UNKNOWN;
+}
+
+#define OEBB_PATH_DEPARTURE OEBB_KEY_PARAMS, OEBB_KEY_DATA, OEBB_KEY_DEPARTURES, JSON_KEY_ITEM
+
+void OEBBMonitorParser::copy_value(char* target, size_t size, const char* value, size_t length) {
+    length = std::min(length, size - 1);
+    memcpy(target, value, length);
+    target[length] = '\0';
+}
+
+void OEBBMonitorParser::on_begin(const JsonStreamPath& path, bool is_array) {
+    if (!is_array && path.matches({OEBB_PATH_DEPARTURE})) {
+        this->line[0] = '\0';
+        this->track[0] = '\0';
+        this->destination[0] = '\0';
+        this->scheduled = 0;
+        this->expected = 0;
+        this->is_cancelled = false;
+        this->is_airport = false;
+    }
+}
+
+void OEBBMonitorParser::on_end(const JsonStreamPath& path, bool is_array) {
+    if (!is_array && path.matches({OEBB_PATH_DEPARTURE})) {
+        this->merge_departure();
+    }
+}
+
+void OEBBMonitorParser::on_value(const JsonStreamPath& path, JsonStreamValue type, const char* value, size_t length) {
+    const bool is_string = type == JSON_STREAM_STRING;
+    const bool is_scalar = is_string || type == JSON_STREAM_NUMBER;
+    if (path.matches({OEBB_PATH_DEPARTURE, path.back()})) {
+        switch (path.back()) {
+            case OEBB_KEY_LINE:
+                if (is_scalar) copy_value(this->line, sizeof(this->line), value, length);
+                break;
+            case OEBB_KEY_TRACK:
+                if (is_scalar) copy_value(this->track, sizeof(this->track), value, length);
+                break;
+            case OEBB_KEY_SCHEDULED:
+                if (is_string) this->scheduled = parse_timestamp(value);
+                break;
+            case OEBB_KEY_EXPECTED:
+                if (is_string) this->expected = parse_timestamp(value);
+                break;
+            default:
+                break;
+        }
+    } else if (path.matches({OEBB_PATH_DEPARTURE, OEBB_KEY_DESTINATION, OEBB_KEY_DEFAULT})) {
+        if (is_string) copy_value(this->destination, sizeof(this->destination), value, length);
+    } else if (path.matches({OEBB_PATH_DEPARTURE, OEBB_KEY_FLAGS, JSON_KEY_ITEM})) {
+        if (!is_string) return;
+        if (strcmp(value, "CANCELED") == 0) {
+            this->is_cancelled = true;
+        } else if (strcmp(value, "AIRPORT") == 0) {
+            // ToDo add Airplane symbol to screen
+            this->is_airport = true;
+        }
+    } else if (path.matches({OEBB_KEY_METHOD})) {
+        this->is_update_method = is_string && strcmp(value, "update") == 0;
+    } else if (path.matches({OEBB_KEY_ID})) {
+        // Kept as raw text, it is only echoed in the acknowledgement
+        this->is_id_string = is_string;
+        if (is_scalar && length < sizeof(this->id)) {
+            copy_value(this->id, sizeof(this->id), value, length);
         }
     }
 }
 
-OEBBDeparture::OEBBDeparture() : internal_mutex(nullptr), handle_task_traffic(nullptr), notification(nullptr) {
-    this->internal_mutex = xSemaphoreCreateMutex();
+void OEBBMonitorParser::merge_departure() {
+    // Filtered and cancelled departures are rejected before any string is built
+    if (this->is_cancelled || !this->filter->matches(this->line, this->destination)) {
+        return;
+    }
+    // Departures are keyed by line, track and times, summing their hashes ignores the order
+    time_t times[2] = {this->scheduled, this->expected};
+    uint32_t departure_hash = hash(2166136261u, this->line, strlen(this->line));
+    departure_hash = hash(departure_hash, this->track, strlen(this->track));
+    departure_hash = hash(departure_hash, reinterpret_cast<const char*>(times), sizeof(times));
+    departure_hash = hash(departure_hash, this->destination, strlen(this->destination));
+    departure_hash = hash(departure_hash, this->is_airport ? "A" : "", this->is_airport ? 1 : 0);
+    this->content_hash += departure_hash;
+
+    String line_name = this->line;
+    // const JsonObject via = departure["via"];
+    // String via_txt = Screen::ConvertGermanToLatin(via["default"].as<String>());
+    // via_txt.replace("&#8203;", "");
+    String stop = this->station_name + ": Platform " + this->track;
+    String towards = Screen::ConvertGermanToLatin(String(this->destination));
+    Monitor* monitor_p = this->monitor_index.find(line_name, stop);
+    Monitor monitor;
+    if (!monitor_p) {
+        monitor.line = line_name;
+        monitor.stop = stop;
+        monitor.towards = towards;
+        monitor.is_barrier_free = false;
+    }
+
+    Vehicle vehicle;
+    time_t departure = this->expected ? this->expected : this->scheduled;
+    vehicle.countdown = static_cast<int>(difftime(departure, this->now) / 60);
+    vehicle.departure = departure;
+    vehicle.line = line_name;
+    vehicle.towards = towards;
+    vehicle.is_barrier_free = false;
+    vehicle.has_folding_ramp = false;
+    vehicle.is_cancelled = false;
+    vehicle.is_airport = this->is_airport;
+    if (monitor_p) {
+        //Monitor with line name already exists -> different towards
+        monitor_p->vehicles.push_back(vehicle);
+    } else {
+        // New monitor with linename and stop
+        monitor.vehicles.push_back(vehicle);
+        this->monitor_index.insert(std::move(monitor));
+    }
+}
+
+void OEBBMonitorParser::on_document_end() {
+    if (this->monitors.size()) {
+        Serial.printf("Received %d monitor from OEBB API.\n", this->monitors.size());
+    }
+    for (auto& m: this->monitors) {
+        sort_vehicles(m.vehicles);
+    }
+}
+
+OEBBDeparture::OEBBDeparture()
+    : DepartureSource("OEBB"), station_count(0), station_generation(0), handle_task_traffic(nullptr), handle_task_parse(nullptr), handle_task_refresh(nullptr), ack_queue(nullptr),
+      frame_ring("OEBB frames", OEBB_FRAME_SLOT_SIZE, OEBB_FRAME_SLOTS),
+      monitor_parser(pending_monitors), station_arena("OEBB station", ARENA_SIZE_OEBB_STATION) {
+    this->ack_queue = xQueueCreate(OEBB_FRAME_SLOTS, sizeof(OEBBAck));
 }
 
 void OEBBDeparture::setup() {
-    this->get_station();
-    if (this->station_id.length() > 0){
-        this->close();// If it was setup already, close the existing departure board
-        String loader_url = "/abfahrtankunft/webdisplay/web_client/ws/?stationId=" + this->station_id + "&contentType=departure&staticLayout=true&page=1&offset=0&ignoreIncident=false&expandAll=false";
-        this->web_socket.beginSSL("meine.oebb.at", 443, loader_url, "", "");
-        this->web_socket.setExtraHeaders("Origin: https://meine.oebb.at");
-        this->web_socket.onEvent([this](WStype_t type, uint8_t * payload, size_t length) {
-            this->event(type, payload, length);
-        });
-        this->web_socket.setReconnectInterval(5000);
+    Configuration& config = Configuration::getInstance();
+    this->close();// If it was setup already, close the existing departure boards
+    // Acknowledgements of the old connections must not be sent on the new ones
+    xQueueReset(this->ack_queue);
+    this->set_stations(config.get_eva());
+    size_t resolved = 0;
+    for (size_t i = 0; i < this->station_count; i++) {
+        // Cached stations are used right away, they are refreshed in the background once connected
+        if (this->load_station(this->stations[i])) {
+            this->connect_socket(i);
+            resolved++;
+        } else {
+            // Retried by the refresh task after STATION_REFRESH_RETRY_DELAY
+            this->stations[i].refresh_attempt = millis();
+        }
+    }
+    if (this->station_count > 0){
+        if(this->handle_task_parse == nullptr && this->frame_ring.begin()){
+            BaseType_t status = xTaskCreatePinnedToCore(this->task_parse, "WS_Parse_Task", 1024 * 12, this, 1, &handle_task_parse, APP_CPU_NUM);
+            if(status != pdTRUE){
+                Serial.printf("Could not create parse task for OEBB: %d\n", status);
+            }
+        }
+        if(this->handle_task_refresh == nullptr){
+            BaseType_t status = xTaskCreatePinnedToCore(this->task_refresh, "WS_Refresh_Task", 1024 * 12, this, 1, &handle_task_refresh, APP_CPU_NUM);
+            if(status != pdTRUE){
+                Serial.printf("Could not create refresh task for OEBB: %d\n", status);
+            }
+        }
         if(this->handle_task_traffic == nullptr){
             BaseType_t status = xTaskCreatePinnedToCore(this->task_traffic, "WS_Task", 1024 * 24, this, 1, &handle_task_traffic, APP_CPU_NUM);
             if(status != pdTRUE){
@@ -298,14 +791,28 @@ void OEBBDeparture::setup() {
         } else {
             vTaskResume(this->handle_task_traffic);
         }
-    } else {
+    }
+    if (this->station_count == 0) {
         Serial.println(F("Setup of OEBB departure board failed."));
+    } else if (resolved < this->station_count) {
+        Serial.printf("Setup of OEBB departure board failed for %d of %d stations.\n", this->station_count - resolved, this->station_count);
     }
 }
 
 void OEBBDeparture::close() {
-    if (this->web_socket.isConnected()) {
-        this->web_socket.disconnect();
+    for (size_t i = 0; i < this->station_count; i++) {
+        OEBBStation& station = this->stations[i];
+        if (station.web_socket.isConnected()) {
+            station.web_socket.disconnect();
+        }
+        if (xSemaphoreTake(this->internal_mutex, portMAX_DELAY) == pdTRUE) {
+            OEBBConnectionStats& stats = station.connection_stats;
+            if (stats.state == OEBB_CONNECTED) {
+                stats.uptime_ms += millis() - stats.connected_since;
+            }
+            stats.state = OEBB_IDLE;
+            xSemaphoreGive(this->internal_mutex);
+        }
     }
     if(this->handle_task_traffic != nullptr){
         vTaskSuspend(this->handle_task_traffic);
@@ -313,18 +820,33 @@ void OEBBDeparture::close() {
 }
 
 bool OEBBDeparture::is_connected() {
-    return this->web_socket.isConnected();
+    for (size_t i = 0; i < this->station_count; i++) {
+        if (this->stations[i].web_socket.isConnected()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+FrameRingStats OEBBDeparture::get_frame_stats() const {
+    return this->frame_ring.get_stats();
 }
 
-void OEBBDeparture::set_notification(TaskHandle_t task){
-    this->notification = task;
+size_t OEBBDeparture::get_station_count() {
+    return this->station_count;
 }
 
-void OEBBDeparture::get_latest_snapshot(std::vector<Monitor>& data){
-    data.clear();
-    // Lock briefly just to copy the internal vector
+bool OEBBDeparture::get_connection_stats(size_t idx, OEBBConnectionStats& stats) {
+    bool is_valid = false;
     if (xSemaphoreTake(this->internal_mutex, portMAX_DELAY) == pdTRUE) {
-        data.insert(data.end(), this->monitors.begin(), this->monitors.end());
+        if (idx < this->station_count) {
+            stats = this->stations[idx].connection_stats;
+            if (stats.state == OEBB_CONNECTED) {
+                stats.uptime_ms += millis() - stats.connected_since;
+            }
+            is_valid = true;
+        }
         xSemaphoreGive(this->internal_mutex);
     }
+    return is_valid;
 }
@@ -0,0 +1,74 @@
+#include "config.h"
+#include "poll_scheduler.h"
+
+PollScheduler::PollScheduler(const char* name) : name(name), consecutive_errors(0), has_error(false) {}
+
+void PollScheduler::begin_poll() {
+    this->has_error = false;
+}
+
+void PollScheduler::report_error() {
+    this->has_error = true;
+}
+
+uint32_t PollScheduler::get_consecutive_errors() const {
+    return this->consecutive_errors;
+}
+
+int PollScheduler::current_countdown(const Vehicle& vehicle, time_t now) {
+    if (vehicle.departure && now >= MIN_VALID_EPOCH) {
+        return static_cast<int>(floor(difftime(vehicle.departure, now) / 60.0));
+    }
+    // Without a departure time or a synchronised clock only the countdown of the response is known
+    return vehicle.countdown;
+}
+
+uint32_t PollScheduler::next_delay(const std::vector<Monitor>& monitors) {
+    if (this->has_error) {
+        this->consecutive_errors++;
+        uint32_t delay = DATA_UPDATE_DELAY;
+        for (uint32_t i = 1; i < this->consecutive_errors && delay < POLL_DELAY_MAX_BACKOFF; i++) {
+            delay *= 2;
+        }
+        delay = std::min<uint32_t>(delay, POLL_DELAY_MAX_BACKOFF);
+        Serial.printf("[%s] Next poll in %d s: backoff after %d errors.\n", this->name, delay / 1000, this->consecutive_errors);
+        return delay;
+    }
+    this->consecutive_errors = 0;
+
+    const time_t now = time(nullptr);
+    bool has_departure = false;
+    int nearest = 0;
+    for (const auto& monitor : monitors) {
+        // Vehicles are sorted by countdown
+        if (monitor.vehicles.empty()) {
+            continue;
+        }
+        const int countdown = current_countdown(monitor.vehicles[0], now);
+        if (!has_departure || countdown < nearest) {
+            nearest = countdown;
+            has_departure = true;
+        }
+    }
+
+    uint32_t delay;
+    const char* reason;
+    if (!has_departure) {
+        delay = POLL_DELAY_IDLE;
+        reason = "no departures";
+    } else if (nearest <= POLL_IMMINENT_COUNTDOWN) {
+        delay = POLL_DELAY_FAST;
+        reason = "departure imminent";
+    } else if (nearest >= POLL_IDLE_COUNTDOWN) {
+        delay = POLL_DELAY_IDLE;
+        reason = "service paused";
+    } else if (nearest >= POLL_DISTANT_COUNTDOWN) {
+        delay = POLL_DELAY_SLOW;
+        reason = "next departure far away";
+    } else {
+        delay = DATA_UPDATE_DELAY;
+        reason = "regular";
+    }
+    Serial.printf("[%s] Next poll in %d s: %s (nearest departure %d min).\n", this->name, delay / 1000, reason, nearest);
+    return delay;
+}
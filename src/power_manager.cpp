@@ -29,6 +29,8 @@ void PowerManager::configure_wifi_manager() {
     static String prompt_count = StringDatabase::GetLineCountPrompt(LIMIT_MIN_NUMBER_LINES, LIMIT_MAX_NUMBER_LINES, DEFAULT_NUMBER_LINES);
     static String val_count    = String(config.get_number_lines());
     
+    static String prompt_display = StringDatabase::GetDisplayModePrompt();
+
     static String prompt_filter_rbl = StringDatabase::GetRBLFilterPrompt();
     static String val_filter_rbl    = config.get_rbl_filter();
     
@@ -36,7 +38,7 @@ void PowerManager::configure_wifi_manager() {
     static String val_filter_eva    = config.get_eva_filter();
 
     static WiFiManagerParameter param_eco(PARAM_ID_ECO, prompt_eco.c_str(), String(config.get_eco_mode()).c_str(), 2);
-    static WiFiManagerParameter param_rbl(PARAM_ID_RBL, prompt_rbl.c_str(), config.get_rbl().c_str(), 64);
+    static WiFiManagerParameter param_rbl(PARAM_ID_RBL, prompt_rbl.c_str(), config.get_rbl().c_str(), 256);
     static WiFiManagerParameter param_eva(PARAM_ID_EVA, prompt_eva.c_str(), config.get_eva().c_str(), 64);
     static WiFiManagerParameter param_count(
         PARAM_ID_COUNT,
@@ -44,6 +46,7 @@ void PowerManager::configure_wifi_manager() {
         String(config.get_number_lines()).c_str(),
         64
     );
+    static WiFiManagerParameter param_display(PARAM_ID_DISPLAY, prompt_display.c_str(), String(config.get_display_mode()).c_str(), 2);
     static WiFiManagerParameter param_filter_rbl(PARAM_ID_FILTER_RBL, prompt_filter_rbl.c_str(), config.get_rbl_filter().c_str(), 64);
     static WiFiManagerParameter param_filter_eva(PARAM_ID_FILTER_EVA, prompt_filter_eva.c_str(), config.get_eva_filter().c_str(), 64);
     static WiFiManagerParameter html_hline("<hr>");
@@ -58,6 +61,7 @@ void PowerManager::configure_wifi_manager() {
     wifi_manager.addParameter(&param_filter_eva);
     wifi_manager.addParameter(&html_hline);
     wifi_manager.addParameter(&param_count);
+    wifi_manager.addParameter(&param_display);
 }
 
 void PowerManager::save_wfi_manager_parameters(WiFiManager& wifi_manager){
@@ -78,6 +82,8 @@ void PowerManager::save_wfi_manager_parameters(WiFiManager& wifi_manager){
             config.set_eva_filter(parameter.getValue());
         } else if (id == PARAM_ID_COUNT){
             config.set_number_lines(String(parameter.getValue()).toInt());
+        } else if (id == PARAM_ID_DISPLAY){
+            config.set_display_mode(String(parameter.getValue()).toInt());
         }
     }
 }
@@ -166,7 +172,11 @@ void PowerManager::reconfigure() {
             vTaskDelay(pdMS_TO_TICKS(50));
         }
 
+        Configuration& config = Configuration::getInstance();
+        const String rbl = config.get_rbl();
+        const String rbl_filter = config.get_rbl_filter();
         this->save_wfi_manager_parameters(wifi_manager);
+        const bool is_rbl_changed = config.get_rbl() != rbl || config.get_rbl_filter() != rbl_filter;
 
         wifi_manager.stopWebPortal();
 
@@ -179,6 +189,9 @@ void PowerManager::reconfigure() {
         } else {
             this->_tft.fillScreen(COLOR_BG);
             this->task_resume();
+            if (is_rbl_changed) {
+                action_rbl_changed();
+            }
         }
         screen.release();
     }
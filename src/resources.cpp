@@ -24,6 +24,10 @@ String StringDatabase::GetPowerModePrompt() {
   return String(EcoPrompt);
 }
 
+String StringDatabase::GetDisplayModePrompt() {
+  return String(DisplayModePrompt);
+}
+
 String StringDatabase::GetLineCountPrompt(int min, int max, int def) {
   String range = StringDatabase::GetFormatRange(min, max);
   String result =
@@ -123,8 +123,9 @@ void Screen::SetRowCount(int num_rows){
 void Screen::SetRows(const std::vector<ScreenEntity>& vec_screen_entity) {
     // Calculate the sizes before rendering and take the max of each row
     const GFXfont* p_font = &FreeSansBold24pt7b;
-    std::vector<int> sizes_name;
-    std::vector<int> sizes_countdown;
+    // Only the maximum is needed, called every frame so nothing is collected
+    int max_size_name = 0;
+    int max_size_countdown = 0;
     for (size_t i = 0; i < vec_screen_entity.size(); ++i) {
         if (i > cnt_rows - 1) {
             return;
@@ -132,16 +133,16 @@ void Screen::SetRows(const std::vector<ScreenEntity>& vec_screen_entity) {
         const ScreenEntity& monitor = vec_screen_entity[i];
         
         // Calculate max Sides text block size.
-        sizes_name.push_back(CalculateFontWidth_px(p_font, monitor.right_txt));
-        sizes_countdown.push_back(CalculateFontWidth_px(p_font, monitor.left_txt));
+        const int size_name = CalculateFontWidth_px(p_font, monitor.right_txt);
+        const int size_countdown = CalculateFontWidth_px(p_font, monitor.left_txt);
+        max_size_name = i == 0 ? size_name : std::max(max_size_name, size_name);
+        max_size_countdown = i == 0 ? size_countdown : std::max(max_size_countdown, size_countdown);
     }
-    if (sizes_name.size() > 0) {
-        SetMaxNameTextWidth_px(*std::max_element(sizes_name.begin(), sizes_name.end()));
+    if (vec_screen_entity.size() > 0) {
+        SetMaxNameTextWidth_px(max_size_name);
+        SetMaxCountdownTextWidth_px(max_size_countdown);
     }
-    if (sizes_countdown.size() > 0) {
-        SetMaxCountdownTextWidth_px(*std::max_element(sizes_countdown.begin(), sizes_countdown.end()));
-    }
-        
+
     for (size_t i = 0; i < vec_screen_entity.size(); ++i) {
         DrawRow(vec_screen_entity[i], i);
     }
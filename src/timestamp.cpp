@@ -0,0 +1,69 @@
+#include "timestamp.h"
+
+// Days since 1970-01-01 of a proleptic Gregorian date (Howard Hinnant's days_from_civil)
+static long days_from_civil(long year, unsigned month, unsigned day) {
+    year -= month <= 2;
+    const long era = (year >= 0 ? year : year - 399) / 400;
+    const unsigned year_of_era = static_cast<unsigned>(year - era * 400);
+    const unsigned day_of_year = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    const unsigned day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+    return era * 146097 + static_cast<long>(day_of_era) - 719468;
+}
+
+// Reads exactly count digits, returns -1 if one of them is not a digit
+static int parse_digits(const char* s, int count) {
+    int value = 0;
+    for (int i = 0; i < count; i++) {
+        if (s[i] < '0' || s[i] > '9') {
+            return -1;
+        }
+        value = value * 10 + (s[i] - '0');
+    }
+    return value;
+}
+
+time_t timegm(struct tm *const t){
+    // Pure arithmetic, the timezone of the other tasks is not touched
+    long year = t->tm_year + 1900L + t->tm_mon / 12;
+    int month = t->tm_mon % 12;
+    if (month < 0) {
+        month += 12;
+        year--;
+    }
+    long days = days_from_civil(year, month + 1, 1) + t->tm_mday - 1;
+    return static_cast<time_t>(days) * 86400 + t->tm_hour * 3600L + t->tm_min * 60L + t->tm_sec;
+}
+
+time_t parse_timestamp(const char* s) {
+    // Fixed layout "YYYY-MM-DDTHH:MM:SS"
+    const int year = parse_digits(s, 4);
+    const int month = year < 0 || s[4] != '-' ? -1 : parse_digits(s + 5, 2);
+    const int day = month < 0 || s[7] != '-' ? -1 : parse_digits(s + 8, 2);
+    const int hour = day < 0 || (s[10] != 'T' && s[10] != ' ') ? -1 : parse_digits(s + 11, 2);
+    const int minute = hour < 0 || s[13] != ':' ? -1 : parse_digits(s + 14, 2);
+    const int second = minute < 0 || s[16] != ':' ? -1 : parse_digits(s + 17, 2);
+    if (second < 0 || month < 1 || month > 12 || day < 1 || day > 31 || hour > 23 || minute > 59 || second > 60) {
+        return 0;
+    }
+    s += 19;
+    // Skip fractional seconds
+    if (*s == '.') {
+        s++;
+        while (*s >= '0' && *s <= '9') s++;
+    }
+    long offset = 0;
+    if (*s == '+' || *s == '-') {
+        const int hours = parse_digits(s + 1, 2);
+        const int minutes = hours < 0 ? -1 : parse_digits(s + (s[3] == ':' ? 4 : 3), 2);
+        if (hours < 0 || minutes < 0) {
+            return 0;
+        }
+        offset = (hours * 60L + minutes) * 60L;
+        if (*s == '-') offset = -offset;
+    } else if (*s != 'Z' && *s != '\0') {
+        return 0;
+    }
+
+    const long days = days_from_civil(year, month, day);
+    return static_cast<time_t>(days) * 86400 + hour * 3600L + minute * 60L + second - offset;
+}
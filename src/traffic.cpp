@@ -1,3 +1,4 @@
+#include "alloc_counter.h"
 #include "config.h"
 #include "screen.h"
 #include "traffic.h"
@@ -7,14 +8,135 @@ TraficManager& TraficManager::getInstance() {
     return instance;
 }
 
-TraficManager::TraficManager(): shift_cnt(0), countdown_idx(0), p_trafic_clock(nullptr) {
-    this->internal_mutex = xSemaphoreCreateMutex();
+TraficManager::TraficManager(): pending_trafic_set(nullptr), shift_cnt(0), countdown_idx(0), p_trafic_clock(nullptr), model_version(0) {}
+
+static uint32_t hash_string(uint32_t hash, const String& str) {
+    // FNV-1a
+    for (size_t i = 0; i < str.length(); i++) {
+        hash = (hash ^ static_cast<uint8_t>(str[i])) * 16777619u;
+    }
+    return hash;
+}
+
+// Power of two, so the probe can use a mask
+static size_t table_size(size_t count) {
+    size_t size = 16;
+    while (size < 2 * count) {
+        size <<= 1;
+    }
+    return size;
+}
+
+MonitorIndex::MonitorIndex() : monitors(nullptr), count(0) {}
+
+uint32_t MonitorIndex::hash(const String& line_name, const String& stop_name) {
+    uint32_t hash = hash_string(2166136261u, line_name);
+    hash = (hash ^ 0xFF) * 16777619u; // Separator, so "1"+"23" != "12"+"3"
+    return hash_string(hash, stop_name);
+}
+
+void MonitorIndex::attach(std::vector<Monitor>& monitors) {
+    this->monitors = &monitors;
+    this->count = 0;
+    this->slots.assign(table_size(monitors.size()), Slot{0, -1});
+    for (size_t i = 0; i < monitors.size(); i++) {
+        this->insert_slot(hash(monitors[i].line, monitors[i].stop), static_cast<int32_t>(i));
+    }
+}
+
+void MonitorIndex::insert_slot(uint32_t hash, int32_t idx) {
+    const size_t mask = this->slots.size() - 1;
+    size_t pos = hash & mask;
+    while (this->slots[pos].idx != -1) {
+        pos = (pos + 1) & mask;
+    }
+    this->slots[pos] = Slot{hash, idx};
+    this->count++;
+}
+
+void MonitorIndex::grow() {
+    std::vector<Slot> old_slots;
+    old_slots.swap(this->slots);
+    this->slots.assign(old_slots.size() * 2, Slot{0, -1});
+    this->count = 0;
+    for (const auto& slot : old_slots) {
+        if (slot.idx != -1) {
+            this->insert_slot(slot.hash, slot.idx);
+        }
+    }
 }
 
-Monitor* findMonitor(std::vector<Monitor>& monitors, const String& line_name, const String& stop_name) {
-    for (auto& m : monitors) {
-        if (m.line == line_name && m.stop == stop_name) {
-            return &m;
+Monitor* MonitorIndex::find(const String& line_name, const String& stop_name) {
+    if (this->monitors == nullptr || this->slots.empty()) {
+        return nullptr;
+    }
+    const uint32_t h = hash(line_name, stop_name);
+    const size_t mask = this->slots.size() - 1;
+    for (size_t pos = h & mask; this->slots[pos].idx != -1; pos = (pos + 1) & mask) {
+        if (this->slots[pos].hash == h) {
+            Monitor& m = (*this->monitors)[this->slots[pos].idx];
+            if (m.line == line_name && m.stop == stop_name) {
+                return &m;
+            }
+        }
+    }
+    return nullptr;
+}
+
+Monitor* MonitorIndex::insert(const Monitor& monitor) {
+    return this->insert(Monitor(monitor));
+}
+
+Monitor* MonitorIndex::insert(Monitor&& monitor) {
+    // Keep the load factor below 0.5
+    if (2 * (this->count + 1) > this->slots.size()) {
+        this->grow();
+    }
+    const uint32_t h = hash(monitor.line, monitor.stop);
+    this->monitors->push_back(std::move(monitor));
+    this->insert_slot(h, static_cast<int32_t>(this->monitors->size() - 1));
+    return &this->monitors->back();
+}
+
+TrafficInfoIndex::TrafficInfoIndex() : infos(nullptr) {}
+
+void TrafficInfoIndex::build(const std::vector<TrafficInfo>& infos) {
+    size_t count = 0;
+    for (const auto& info : infos) {
+        count += info.related_lines.size();
+    }
+    this->infos = &infos;
+    this->slots.assign(table_size(count), Slot{0, -1, nullptr});
+    const size_t mask = this->slots.size() - 1;
+    for (size_t i = 0; i < infos.size(); i++) {
+        for (const auto& line : infos[i].related_lines) {
+            const uint32_t h = hash_string(2166136261u, line);
+            size_t pos = h & mask;
+            bool is_known = false;
+            while (this->slots[pos].idx != -1) {
+                if (this->slots[pos].hash == h && *this->slots[pos].line == line) {
+                    // The first info of a line wins
+                    is_known = true;
+                    break;
+                }
+                pos = (pos + 1) & mask;
+            }
+            if (!is_known) {
+                this->slots[pos] = Slot{h, static_cast<int32_t>(i), &line};
+            }
+        }
+    }
+}
+
+const TrafficInfo* TrafficInfoIndex::find(const String& line_name) const {
+    if (this->infos == nullptr || this->slots.empty()) {
+        return nullptr;
+    }
+    const uint32_t h = hash_string(2166136261u, line_name);
+    const size_t mask = this->slots.size() - 1;
+    for (size_t pos = h & mask; this->slots[pos].idx != -1; pos = (pos + 1) & mask) {
+        if (this->slots[pos].hash == h && *this->slots[pos].line == line_name) {
+            return &(*this->infos)[this->slots[pos].idx];
         }
     }
     return nullptr;
@@ -70,26 +192,84 @@ void TrafficClock::PrintTime() const {
     Serial.println(Milliseconds());
 }
 
-template<typename T>
-std::vector<T> cyclicSubset(const std::vector<T>& input, size_t N, size_t start) {
-  std::vector<T> result;
-  size_t size = input.size();
+MonitorPage::MonitorPage() : count(0) {}
 
-  // If the input vector is empty or N is 0, return an empty result.
-  if (input.empty() || N == 0) {
-    return result;
-  }
+void MonitorPage::assign(const std::vector<Monitor>& monitors, size_t count, size_t start) {
+    this->count = 0;
+    // If the input vector is empty or count is 0, the page stays empty
+    if (monitors.empty()) {
+        return;
+    }
+    count = std::min(count, static_cast<size_t>(LIMIT_MAX_NUMBER_LINES));
+    for (size_t i = start; i < start + count; ++i) {
+        this->rows[this->count++] = &monitors[i % monitors.size()];
+    }
+}
 
-  // Let's start with the start element and add elements to the result.
-  for (size_t i = start; i < start + N; ++i) {
-    result.push_back(input[i % size]);
-  }
+void MonitorPage::sort() {
+    std::sort(
+        this->rows, this->rows + this->count,
+        [](const Monitor* a, const Monitor* b) {
+          return a->vehicles[0].countdown < b->vehicles[0].countdown;
+        }
+    );
+}
+
+size_t MonitorPage::size() const {
+    return this->count;
+}
+
+bool MonitorPage::empty() const {
+    return this->count == 0;
+}
 
-  return result;
+const Monitor& MonitorPage::operator[](size_t idx) const {
+    return *this->rows[idx];
+}
+
+bool DepartureList::is_later(const Cursor& a, const Cursor& b) {
+    return a.countdown > b.countdown || (a.countdown == b.countdown && a.monitor > b.monitor);
+}
+
+void DepartureList::build(const std::vector<Monitor>& monitors, size_t limit) {
+    this->departures.clear();
+    this->heap.clear();
+    for (size_t i = 0; i < monitors.size(); i++) {
+        if (!monitors[i].vehicles.empty()) {
+            this->heap.push_back(Cursor{monitors[i].vehicles[0].countdown, i, 0});
+        }
+    }
+    std::make_heap(this->heap.begin(), this->heap.end(), is_later);
+    while (!this->heap.empty() && this->departures.size() < limit) {
+        std::pop_heap(this->heap.begin(), this->heap.end(), is_later);
+        Cursor& next = this->heap.back();
+        const Monitor& monitor = monitors[next.monitor];
+        this->departures.push_back(Departure{&monitor, &monitor.vehicles[next.vehicle]});
+        if (++next.vehicle < monitor.vehicles.size()) {
+            // The monitor goes back with its following vehicle
+            next.countdown = monitor.vehicles[next.vehicle].countdown;
+            std::push_heap(this->heap.begin(), this->heap.end(), is_later);
+        } else {
+            this->heap.pop_back();
+        }
+    }
+}
+
+size_t DepartureList::size() const {
+    return this->departures.size();
+}
+
+bool DepartureList::empty() const {
+    return this->departures.empty();
+}
+
+const Departure& DepartureList::operator[](size_t idx) const {
+    return this->departures[idx];
 }
 
 TraficManager::~TraficManager() {
     deleteClock();
+    delete pending_trafic_set.exchange(nullptr);
 }
 
 bool TraficManager::hasClock() {
@@ -116,6 +296,9 @@ void TraficManager::createClock() {
     } else {
         f_size = static_cast<double>(all_trafic_set.size());
     }
+    if (page_plan.mode == DISPLAY_NEXT_DEPARTURES) {
+        f_size = static_cast<double>(std::max(next_departures.size(), static_cast<size_t>(1)));
+    }
     double f_sceen_cells = static_cast<double>(screen.GetNumberRows());
 
     long iterations_cnt = static_cast<long>(ceil(f_size / f_sceen_cells));
@@ -130,46 +313,186 @@ void TraficManager::createClock() {
 
 }
 
-BaseType_t TraficManager::acquire(){
-    return xSemaphoreTake(this->internal_mutex, portMAX_DELAY);
-}
-
-void TraficManager::release(){
-    xSemaphoreGive(this->internal_mutex);
-}
-
 bool TraficManager::has_data() {
   return !all_trafic_set.empty();
 }
 
 // Block 1: Update Traffic Data
-void TraficManager::update(const std::vector<Monitor>& vec) {
-    Screen& screen = Screen::getInstance();
-    prev_iterations = 0;
+void TraficManager::update(std::vector<Monitor>&& vec) {
     if (vec.size() > 0){
         Serial.printf("Updating data with %d monitors:\n", vec.size());
         for (auto& monitor : vec) {
             Serial.printf("  Monitor for %s towards %s.\n", monitor.line, monitor.towards);
         }
     }
-    if (hasClock()) {
-        const int trafic_set_size = static_cast<int>(vec.size());
-        if (hasClock()) p_trafic_clock->Reset();
+    std::vector<Monitor>* next = new std::vector<Monitor>(std::move(vec));
+    // A model the screen task did not pick up yet is superseded
+    delete pending_trafic_set.exchange(next, std::memory_order_acq_rel);
+}
 
+void TraficManager::adopt_pending() {
+    std::unique_ptr<std::vector<Monitor>> next(pending_trafic_set.exchange(nullptr, std::memory_order_acq_rel));
+    if (!next) {
+        return;
+    }
+    Screen& screen = Screen::getInstance();
+    if (!page_plan.pages.empty()) {
+        const int trafic_set_size = static_cast<int>(next->size());
         int rows_in_screen_cnt = std::min(screen.GetNumberRows(), trafic_set_size);
-        auto currentTraficSubset = cyclicSubset(all_trafic_set, rows_in_screen_cnt, shift_cnt);
-        auto futureTraficSubset = cyclicSubset(vec, rows_in_screen_cnt, shift_cnt);
+        MonitorPage futureTraficSubset;
+        futureTraficSubset.assign(*next, rows_in_screen_cnt, shift_cnt);
+        futureTraficSubset.sort();
+        SelectiveReset(page_plan.pages[page_plan.page], futureTraficSubset);
+    }
+    // The pages point into the previous model, which is released with next
+    page_plan.pages.clear();
+    page_plan.page_count = 0;
+    all_trafic_set.swap(*next);
+    if (page_plan.mode == DISPLAY_NEXT_DEPARTURES) {
+        next_departures.build(all_trafic_set, NEXT_DEPARTURES_COUNT);
+    }
+    // Recompute the countdowns of the new data with this frame
+    last_countdown_update = 0;
+}
 
-        sortTrafic(currentTraficSubset);
-        sortTrafic(futureTraficSubset);
-        SelectiveReset(currentTraficSubset, futureTraficSubset);
+void TraficManager::build_plan(int rows) {
+    const size_t trafic_set_size = all_trafic_set.size();
+    page_plan.rows = rows;
+    page_plan.page = 0;
+    if (page_plan.mode == DISPLAY_NEXT_DEPARTURES) {
+        // Consecutive slices of the list, the soonest departures are always on the first page
+        const size_t cnt_rows = static_cast<size_t>(std::max(rows, 1));
+        page_plan.pages.clear();
+        page_plan.page_count = std::max((next_departures.size() + cnt_rows - 1) / cnt_rows, static_cast<size_t>(1));
+        deleteClock();
+        createClock();
+        prev_iterations = p_trafic_clock->GetIteration();
+        model_version++;
+        render_stats.plans++;
+        return;
+    }
+    // The page shifts by the number of rows, the sequence repeats after size / gcd(size, rows) pages
+    size_t page_count = 1;
+    if (rows > 0 && trafic_set_size > 0) {
+        size_t a = trafic_set_size;
+        size_t b = static_cast<size_t>(rows);
+        while (b) {
+            size_t t = a % b;
+            a = b;
+            b = t;
+        }
+        page_count = trafic_set_size / a;
+    }
+    const size_t rows_in_screen_cnt = std::min(static_cast<size_t>(std::max(rows, 0)), trafic_set_size);
+    page_plan.pages.resize(page_count);
+    page_plan.page_count = page_count;
+    for (size_t i = 0; i < page_count; i++) {
+        page_plan.pages[i].assign(all_trafic_set, rows_in_screen_cnt, shift_cnt + i * rows);
+        page_plan.pages[i].sort();
+    }
+    // The dwell times depend on the number of pages of the new data
+    deleteClock();
+    createClock();
+    prev_iterations = p_trafic_clock->GetIteration();
+    model_version++;
+    render_stats.plans++;
+}
+
+bool TraficManager::updateCountdowns() {
+    time_t now = time(nullptr);
+    // Only once per second and only if the clock was synchronised
+    if (now == last_countdown_update || now < MIN_VALID_EPOCH) {
+        return false;
+    }
+    last_countdown_update = now;
+    // Most seconds change no minute, the rows are kept then
+    bool is_changed = false;
+    size_t kept = 0;
+    for (size_t i = 0; i < all_trafic_set.size(); i++) {
+        Monitor& monitor = all_trafic_set[i];
+        auto& vehicles = monitor.vehicles;
+        for (auto& vehicle : vehicles) {
+            if (vehicle.departure) {
+                const int countdown = static_cast<int>(floor(difftime(vehicle.departure, now) / 60.0));
+                if (countdown != vehicle.countdown) {
+                    vehicle.countdown = countdown;
+                    is_changed = true;
+                }
+            }
+        }
+        // Vehicles that are gone are dropped, they are sorted to the front
+        size_t departed = 0;
+        while (departed < vehicles.size() && vehicles[departed].departure && vehicles[departed].countdown < 0) {
+            departed++;
+        }
+        if (departed) {
+            vehicles.erase(vehicles.begin(), vehicles.begin() + departed);
+            is_changed = true;
+        }
+        // A line whose last vehicle left is not shown until the next update brings new departures
+        if (departed && vehicles.empty()) {
+            continue;
+        }
+        if (kept != i) {
+            all_trafic_set[kept] = std::move(monitor);
+        }
+        kept++;
+    }
+    if (kept != all_trafic_set.size()) {
+        all_trafic_set.erase(all_trafic_set.begin() + kept, all_trafic_set.end());
+        // The pages point into the vector
+        page_plan.pages.clear();
+        page_plan.page_count = 0;
     }
-    all_trafic_set = vec;
+    return is_changed;
 }
 
 void TraficManager::updateScreen() {
+    const uint32_t allocations = alloc_counter_get();
+    render_frame();
+    render_stats.frames++;
+    render_stats.allocations += alloc_counter_get() - allocations;
+    if (render_stats.frames % RENDER_STATS_FRAMES == 0) {
+        Serial.printf(
+            "[Screen] %u frames, %u allocations, %u page changes, %u plans, %u row builds.\n",
+            render_stats.frames, render_stats.allocations, render_stats.page_changes, render_stats.plans, render_stats.entity_builds
+        );
+    }
+}
+
+RenderStats TraficManager::get_render_stats() const {
+    return render_stats;
+}
+
+void TraficManager::render_frame() {
     Screen& screen = Screen::getInstance();
     Configuration& config = Configuration::getInstance();
+    adopt_pending();
+    const DisplayMode display_mode = config.get_display_mode();
+    if (display_mode != page_plan.mode) {
+        page_plan.mode = display_mode;
+        page_plan.page_count = 0;
+        if (display_mode == DISPLAY_NEXT_DEPARTURES) {
+            next_departures.build(all_trafic_set, NEXT_DEPARTURES_COUNT);
+        }
+    }
+    if (updateCountdowns()) {
+        if (page_plan.mode == DISPLAY_NEXT_DEPARTURES) {
+            // Departed vehicles were erased, the list points to the remaining ones
+            const size_t departure_count = next_departures.size();
+            next_departures.build(all_trafic_set, NEXT_DEPARTURES_COUNT);
+            if (next_departures.size() != departure_count) {
+                page_plan.page_count = 0;
+            }
+        } else {
+            // The first departures might have changed their order
+            for (auto& page : page_plan.pages) {
+                page.sort();
+            }
+        }
+        model_version++;
+    }
+    // Departed vehicles might have removed the last monitor
     if (!this->has_data()) {
         screen.DrawCenteredText("No Real-Time information available.");
         return;
@@ -177,8 +500,10 @@ void TraficManager::updateScreen() {
     const int32_t number_text_lines = config.get_number_lines();
     const int trafic_set_size = static_cast<int>(all_trafic_set.size());
     // Dynamic Row adjustment of screen
-    const int num_rows_old = screen.GetNumberRows();
-    if (trafic_set_size < number_text_lines) {
+    if (page_plan.mode == DISPLAY_NEXT_DEPARTURES) {
+        const int departure_count = static_cast<int>(next_departures.size());
+        screen.SetRowCount(std::max(std::min(departure_count, static_cast<int>(number_text_lines)), 1));
+    } else if (trafic_set_size < number_text_lines) {
         if (trafic_set_size == 1) {
             if (all_trafic_set[0].vehicles.size() < number_text_lines) {
                 screen.SetRowCount(all_trafic_set[0].vehicles.size());
@@ -192,32 +517,37 @@ void TraficManager::updateScreen() {
         screen.SetRowCount(number_text_lines);
     }
     const int cnt_screen_rows = screen.GetNumberRows();
-    int rows_in_screen_cnt = std::min(cnt_screen_rows, trafic_set_size);
-    auto currentTraficSubset = cyclicSubset(all_trafic_set, rows_in_screen_cnt, shift_cnt);
-    if(num_rows_old != cnt_screen_rows){
-        deleteClock();
-        createClock();
+    // Only new data or a different layout require a new plan
+    if (page_plan.page_count == 0 || page_plan.rows != cnt_screen_rows) {
+        build_plan(cnt_screen_rows);
     }
-    sortTrafic(currentTraficSubset);
 
-    if (!hasClock()) {
-        createClock();
-    } else {
-        long cur_iterations = p_trafic_clock->GetIteration();
-        countdown_idx = p_trafic_clock->GetCountdown();
-        if (cur_iterations != prev_iterations) {
-            prev_iterations = cur_iterations;
-            auto futureSubset = cyclicSubset(all_trafic_set, rows_in_screen_cnt, shift_cnt + cnt_screen_rows);
-
-            sortTrafic(futureSubset);
-            SelectiveReset(currentTraficSubset, futureSubset);
+    const size_t current_page = page_plan.page;
+    long cur_iterations = p_trafic_clock->GetIteration();
+    countdown_idx = p_trafic_clock->GetCountdown();
+    if (cur_iterations != prev_iterations) {
+        prev_iterations = cur_iterations;
+        const size_t next_page = (page_plan.page + 1) % page_plan.page_count;
+        if (page_plan.mode == DISPLAY_NEXT_DEPARTURES) {
+            if (next_page != current_page) {
+                // Every row shows another departure
+                screen.FullResetScroll();
+            }
+        } else {
+            SelectiveReset(page_plan.pages[current_page], page_plan.pages[next_page]);
             shift_cnt += cnt_screen_rows;
         }
-        DrawTraficOnScreen(currentTraficSubset);
+        page_plan.page = next_page;
+        render_stats.page_changes++;
+    }
+    if (page_plan.mode == DISPLAY_NEXT_DEPARTURES) {
+        DrawDeparturesOnScreen(current_page);
+    } else {
+        DrawTraficOnScreen(page_plan.pages[current_page]);
     }
 }
 
-void TraficManager::SelectiveReset(const std::vector<Monitor>& currentTraficSubset, const std::vector<Monitor>& futureSubset) {
+void TraficManager::SelectiveReset(const MonitorPage& currentTraficSubset, const MonitorPage& futureSubset) {
     Screen& screen = Screen::getInstance();
     if (currentTraficSubset.size() == futureSubset.size()) {
 
@@ -238,15 +568,6 @@ void TraficManager::SelectiveReset(const std::vector<Monitor>& currentTraficSubs
     }
 }
 
-void TraficManager::sortTrafic(std::vector<Monitor>& v) {
-    std::sort(
-        v.begin(), v.end(),
-        [](const Monitor& a, const Monitor& b) {
-          return a.vehicles[0].countdown < b.vehicles[0].countdown;
-        }
-    );
-}
-
 String TraficManager::GetValidCountdown(const std::vector<Vehicle>& c, size_t index) {
     if (c.empty()) {
       return String();
@@ -256,124 +577,150 @@ String TraficManager::GetValidCountdown(const std::vector<Vehicle>& c, size_t in
     return String(c[best_index].countdown, DEC);
 }
 
-void TraficManager::DrawTraficOnScreen(const std::vector<Monitor>& currentTrafficSubset) {
+void TraficManager::DrawTraficOnScreen(const MonitorPage& currentTrafficSubset) {
     Screen& screen = Screen::getInstance();
     if (currentTrafficSubset.empty()) {
         screen.DrawCenteredText("No Real-Time information available.");
     } else {
-        // Get the number of lines to display
-        size_t numLines = screen.GetNumberRows();
-
-        // Iterate through each line on the screen
-        std::vector<ScreenEntity> vec_screen_entity;
-        // generate entity
-        for (size_t i = 0; i < numLines; ++i) {
-            ScreenEntity monitor;
-            std::vector<String> clean_str;
-            bool accessibility = false;
-            bool airport = false;
-            bool ramp = false;
-            for (size_t x = 0; x < TEXT_ROWS_PER_MONITOR; ++x) {
-                clean_str.push_back("");
-                clean_str.push_back("");
-            }
+        // The rows only change with the data, the page, the countdown slot or the blinking of due departures
+        const ScreenEntityKey key = {
+            model_version, &currentTrafficSubset, 0, countdown_idx, screen.GetNumberRows(), has_due_rows && (millis() / 1000) % 2 != 0
+        };
+        if (!(key == screen_entity_key)) {
+            build_screen_entities(currentTrafficSubset);
+            screen_entity_key = key;
+            render_stats.entity_builds++;
+        }
+        // render entity
+        screen.SetRows(screen_entities);
+    }
+}
 
-            // Check if there's at least one monitor in the subset
-            String towards_display;
-            String traffic_info_display;
-            if (currentTrafficSubset.size() == 1) {
-                // Only one monitor - display vehicles instead
-                const Monitor& currentMonitor = currentTrafficSubset[0];
-                const auto& vehicles = currentMonitor.vehicles;
-                int vehicle_idx;
-                if (screen.GetNumberRows() == vehicles.size()) {
-                    //Ignore countdown index because all data is displayed on one page
-                    vehicle_idx = i;
-                } else {
-                    vehicle_idx = i + numLines*countdown_idx;
-                }
-                if (vehicle_idx < vehicles.size()) {
-                    int has_traffic_info = currentMonitor.traffic_info.description.length();
-                    if (has_traffic_info){
-                        // traffic_info_display = currentMonitor.traffic_info.description;
-                        traffic_info_display = currentMonitor.traffic_info.GetFullString();
-                    } else {
-                        traffic_info_display = currentMonitor.stop;
-                    }                
-                    if (!vehicles.empty()) {
-                        const Vehicle& vehicle = currentMonitor.vehicles[vehicle_idx];
-                        monitor.right_txt = vehicle.line;
-
-                        if (vehicle.countdown <= 0) {
-                            if ((millis() / 1000) % 2) {
-                                monitor.left_txt = String("◱");
-                            } else {
-                                monitor.left_txt = String("◳");
-                            }
-                        } else {
-                            monitor.left_txt = String(vehicle.countdown, DEC);
-                        }
-                        accessibility = vehicle.is_barrier_free;
-                        airport = vehicle.is_airport;
-                        ramp = vehicle.has_folding_ramp;
-                        if (has_traffic_info) {
-                            towards_display = currentMonitor.stop + " - " + vehicle.towards;
-                        } else {
-                            towards_display = vehicle.towards;
-                        }
-                    } else {
-                        accessibility = currentMonitor.is_barrier_free;
-                        if (has_traffic_info) {
-                            towards_display = currentMonitor.stop + " - " + currentMonitor.towards;
-                        } else {
-                            towards_display = currentMonitor.towards;
-                        }
-                    }
-                }
+void TraficManager::DrawDeparturesOnScreen(size_t page) {
+    Screen& screen = Screen::getInstance();
+    if (next_departures.empty()) {
+        screen.DrawCenteredText("No Real-Time information available.");
+    } else {
+        const int rows = screen.GetNumberRows();
+        // A departure has a single countdown, the countdown slot does not change the rows
+        const ScreenEntityKey key = {
+            model_version, nullptr, page * rows, 0, rows, has_due_rows && (millis() / 1000) % 2 != 0
+        };
+        if (!(key == screen_entity_key)) {
+            build_departure_entities(page * rows);
+            screen_entity_key = key;
+            render_stats.entity_builds++;
+        }
+        screen.SetRows(screen_entities);
+    }
+}
+
+void TraficManager::build_departure_entities(size_t first_departure) {
+    Screen& screen = Screen::getInstance();
+    const size_t last_departure = std::min(first_departure + screen.GetNumberRows(), next_departures.size());
+    screen_entities.clear();
+    has_due_rows = false;
+    for (size_t i = first_departure; i < last_departure; ++i) {
+        const Monitor& currentMonitor = *next_departures[i].monitor;
+        const Vehicle& vehicle = *next_departures[i].vehicle;
+        ScreenEntity entity;
+        entity.right_txt = vehicle.line;
+        if (vehicle.countdown <= 0) {
+            has_due_rows = true;
+            if ((millis() / 1000) % 2) {
+                entity.left_txt = String("◱");
             } else {
-                size_t monior_idx = i % currentTrafficSubset.size();
-                // dont heve cyrcular arry
-                if (i > currentTrafficSubset.size() - 1 && currentTrafficSubset.size() > 1) {
-                    break;
-                }
+                entity.left_txt = String("◳");
+            }
+        } else {
+            entity.left_txt = String(vehicle.countdown, DEC);
+        }
+        // Same texts as a row of the monitors mode, the stop tells the monitors apart
+        String towards_display;
+        String traffic_info_display;
+        if (currentMonitor.traffic_info.description.length()) {
+            traffic_info_display = currentMonitor.traffic_info.GetFullString();
+            towards_display = currentMonitor.stop + " - " + vehicle.towards;
+        } else {
+            traffic_info_display = currentMonitor.stop;
+            towards_display = vehicle.towards;
+        }
+        entity.lines.assign(2 * TEXT_ROWS_PER_MONITOR, String());
+        entity.lines[0] = towards_display;
+        entity.lines[1] = traffic_info_display;
+        entity.is_barrier_free = vehicle.is_barrier_free;
+        entity.has_folding_ramp = vehicle.has_folding_ramp;
+        entity.is_airport = vehicle.is_airport;
+        screen_entities.push_back(entity);
+    }
+}
+
+void TraficManager::build_screen_entities(const MonitorPage& currentTrafficSubset) {
+    Screen& screen = Screen::getInstance();
+    // Get the number of lines to display
+    size_t numLines = screen.GetNumberRows();
+
+    // Iterate through each line on the screen
+    std::vector<ScreenEntity>& vec_screen_entity = screen_entities;
+    vec_screen_entity.clear();
+    has_due_rows = false;
+    // generate entity
+    for (size_t i = 0; i < numLines; ++i) {
+        ScreenEntity monitor;
+        std::vector<String> clean_str;
+        bool accessibility = false;
+        bool airport = false;
+        bool ramp = false;
+        for (size_t x = 0; x < TEXT_ROWS_PER_MONITOR; ++x) {
+            clean_str.push_back("");
+            clean_str.push_back("");
+        }
 
-                const Monitor& currentMonitor = currentTrafficSubset[monior_idx];
+        // Check if there's at least one monitor in the subset
+        String towards_display;
+        String traffic_info_display;
+        if (currentTrafficSubset.size() == 1) {
+            // Only one monitor - display vehicles instead
+            const Monitor& currentMonitor = currentTrafficSubset[0];
+            const auto& vehicles = currentMonitor.vehicles;
+            int vehicle_idx;
+            if (screen.GetNumberRows() == vehicles.size()) {
+                //Ignore countdown index because all data is displayed on one page
+                vehicle_idx = i;
+            } else {
+                vehicle_idx = i + numLines*countdown_idx;
+            }
+            if (vehicle_idx < vehicles.size()) {
                 int has_traffic_info = currentMonitor.traffic_info.description.length();
                 if (has_traffic_info){
                     // traffic_info_display = currentMonitor.traffic_info.description;
                     traffic_info_display = currentMonitor.traffic_info.GetFullString();
                 } else {
                     traffic_info_display = currentMonitor.stop;
-                }
-                size_t idx = countdown_idx;
-                if (idx > currentMonitor.vehicles.size() - 1) {
-                    // If one monitor has more vehicles than the other, show the last element longer
-                    idx = currentMonitor.vehicles.size() - 1;
-                    // break;
-                }
-                // Set the right text
-                monitor.right_txt = currentMonitor.line;
+                }                
+                if (!vehicles.empty()) {
+                    const Vehicle& vehicle = currentMonitor.vehicles[vehicle_idx];
+                    monitor.right_txt = vehicle.line;
 
-                if (!currentMonitor.vehicles.empty()) {
-                    const Vehicle& vehicle = currentMonitor.vehicles[idx];
                     if (vehicle.countdown <= 0) {
+                        has_due_rows = true;
                         if ((millis() / 1000) % 2) {
-                          monitor.left_txt = String("◱");
+                            monitor.left_txt = String("◱");
                         } else {
-                          monitor.left_txt = String("◳");
+                            monitor.left_txt = String("◳");
                         }
                     } else {
-                        monitor.left_txt = GetValidCountdown(currentMonitor.vehicles, idx);
+                        monitor.left_txt = String(vehicle.countdown, DEC);
                     }
                     accessibility = vehicle.is_barrier_free;
-                    ramp = vehicle.has_folding_ramp;
                     airport = vehicle.is_airport;
+                    ramp = vehicle.has_folding_ramp;
                     if (has_traffic_info) {
                         towards_display = currentMonitor.stop + " - " + vehicle.towards;
                     } else {
                         towards_display = vehicle.towards;
                     }
-                  } else {
+                } else {
                     accessibility = currentMonitor.is_barrier_free;
                     if (has_traffic_info) {
                         towards_display = currentMonitor.stop + " - " + currentMonitor.towards;
@@ -382,18 +729,68 @@ void TraficManager::DrawTraficOnScreen(const std::vector<Monitor>& currentTraffi
                     }
                 }
             }
+        } else {
+            size_t monior_idx = i % currentTrafficSubset.size();
+            // dont heve cyrcular arry
+            if (i > currentTrafficSubset.size() - 1 && currentTrafficSubset.size() > 1) {
+                break;
+            }
 
-            clean_str[0] = towards_display;
-            if (traffic_info_display.length()) {
-                clean_str[1] = traffic_info_display;
+            const Monitor& currentMonitor = currentTrafficSubset[monior_idx];
+            int has_traffic_info = currentMonitor.traffic_info.description.length();
+            if (has_traffic_info){
+                // traffic_info_display = currentMonitor.traffic_info.description;
+                traffic_info_display = currentMonitor.traffic_info.GetFullString();
+            } else {
+                traffic_info_display = currentMonitor.stop;
+            }
+            size_t idx = countdown_idx;
+            if (idx > currentMonitor.vehicles.size() - 1) {
+                // If one monitor has more vehicles than the other, show the last element longer
+                idx = currentMonitor.vehicles.size() - 1;
+                // break;
+            }
+            // Set the right text
+            monitor.right_txt = currentMonitor.line;
+
+            if (!currentMonitor.vehicles.empty()) {
+                const Vehicle& vehicle = currentMonitor.vehicles[idx];
+                if (vehicle.countdown <= 0) {
+                    has_due_rows = true;
+                    if ((millis() / 1000) % 2) {
+                      monitor.left_txt = String("◱");
+                    } else {
+                      monitor.left_txt = String("◳");
+                    }
+                } else {
+                    monitor.left_txt = GetValidCountdown(currentMonitor.vehicles, idx);
+                }
+                accessibility = vehicle.is_barrier_free;
+                ramp = vehicle.has_folding_ramp;
+                airport = vehicle.is_airport;
+                if (has_traffic_info) {
+                    towards_display = currentMonitor.stop + " - " + vehicle.towards;
+                } else {
+                    towards_display = vehicle.towards;
+                }
+              } else {
+                accessibility = currentMonitor.is_barrier_free;
+                if (has_traffic_info) {
+                    towards_display = currentMonitor.stop + " - " + currentMonitor.towards;
+                } else {
+                    towards_display = currentMonitor.towards;
+                }
             }
-            monitor.lines = clean_str;
-            monitor.is_barrier_free = accessibility;
-            monitor.has_folding_ramp = ramp;
-            monitor.is_airport = airport;
-            vec_screen_entity.push_back(monitor);
         }
-        // render entity
-        screen.SetRows(vec_screen_entity);
+
+        clean_str[0] = towards_display;
+        if (traffic_info_display.length()) {
+            clean_str[1] = traffic_info_display;
+        }
+        monitor.lines = clean_str;
+        monitor.is_barrier_free = accessibility;
+        monitor.has_folding_ramp = ramp;
+        monitor.is_airport = airport;
+        vec_screen_entity.push_back(monitor);
     }
 }
@@ -3,7 +3,7 @@
 #include "screen.h"
 #include "wiener_linien.h"
 
-String WLDeparture::fix_json(const String& word) {
+String WLMonitorParser::fix_json(const String& word) {
     String new_word = Screen::ConvertGermanToLatin(word);
     // Check if the input string contains spaces
     new_word.trim();
@@ -16,279 +16,520 @@ String WLDeparture::fix_json(const String& word) {
   return new_word;
 }
 
+WLMonitorParser::WLMonitorParser(std::vector<Monitor>& monitors)
+    : monitors(monitors), filter(nullptr), is_line_rejected(false), has_departure_time(false), monitor_count(0), content_hash(0) {}
+
+void WLMonitorParser::begin(const LineFilter& filter) {
+    this->monitors.clear();
+    this->monitor_index.attach(this->monitors);
+    this->traffic_infos.clear();
+    this->related_lines.clear();
+    this->filter = &filter;
+    this->is_line_rejected = false;
+    this->monitor_count = 0;
+    // The filter changes the result as well
+    this->content_hash = 2166136261u;
+    this->update_hash(JSON_KEY_UNKNOWN, filter.get_source().c_str(), filter.get_source().length());
+}
+
+uint8_t WLMonitorParser::map_key(const char* key, size_t length) {
+    static const struct { const char* name; WLKey id; } known_keys[] = {
+        {"data", WL_KEY_DATA},
+        {"monitors", WL_KEY_MONITORS},
+        {"locationStop", WL_KEY_LOCATION_STOP},
+        {"properties", WL_KEY_PROPERTIES},
+        {"title", WL_KEY_TITLE},
+        {"lines", WL_KEY_LINES},
+        {"name", WL_KEY_NAME},
+        {"towards", WL_KEY_TOWARDS},
+        {"barrierFree", WL_KEY_BARRIER_FREE},
+        {"foldingRamp", WL_KEY_FOLDING_RAMP},
+        {"departures", WL_KEY_DEPARTURES},
+        {"departure", WL_KEY_DEPARTURE},
+        {"departureTime", WL_KEY_DEPARTURE_TIME},
+        {"countdown", WL_KEY_COUNTDOWN},
+        {"timePlanned", WL_KEY_TIME_PLANNED},
+        {"timeReal", WL_KEY_TIME_REAL},
+        {"vehicle", WL_KEY_VEHICLE},
+        {"trafficInfos", WL_KEY_TRAFFIC_INFOS},
+        {"description", WL_KEY_DESCRIPTION},
+        {"relatedLines", WL_KEY_RELATED_LINES},
+    };
+    for (const auto& known_key : known_keys) {
+        if (strcmp(known_key.name, key) == 0) {
+            return known_key.id;
+        }
+    }
+    return WL_KEY_UNKNOWN;
+}
+
+#define WL_PATH_MONITOR WL_KEY_DATA, WL_KEY_MONITORS, JSON_KEY_ITEM
+#define WL_PATH_LINE WL_PATH_MONITOR, WL_KEY_LINES, JSON_KEY_ITEM
+#define WL_PATH_DEPARTURE WL_PATH_LINE, WL_KEY_DEPARTURES, WL_KEY_DEPARTURE, JSON_KEY_ITEM
+#define WL_PATH_TRAFFIC_INFO WL_KEY_DATA, WL_KEY_TRAFFIC_INFOS, JSON_KEY_ITEM
+
+void WLMonitorParser::on_begin(const JsonStreamPath& path, bool is_array) {
+    if (is_array) return;
+    if (path.matches({WL_PATH_DEPARTURE, WL_KEY_DEPARTURE_TIME})) {
+        this->has_departure_time = true;
+        return;
+    } else if (path.matches({WL_PATH_DEPARTURE})) {
+        if (this->is_line_rejected) return;
+        this->has_departure_time = false;
+        this->vehicle = Vehicle();
+        this->vehicle.countdown = -1;
+        this->vehicle.departure = 0;
+        this->vehicle.is_barrier_free = false;
+        this->vehicle.has_folding_ramp = false;
+        this->vehicle.is_cancelled = false;
+        this->vehicle.is_airport = false;
+    } else if (path.matches({WL_PATH_LINE})) {
+        this->line = Monitor();
+        this->line.is_barrier_free = false;
+        this->is_line_rejected = false;
+    } else if (path.matches({WL_PATH_MONITOR})) {
+        this->stop_name.clear();
+        this->monitor_count++;
+    } else if (path.matches({WL_PATH_TRAFFIC_INFO})) {
+        this->traffic_info = TrafficInfo();
+    } else {
+        return;
+    }
+    // Marks the start of a record, so equal values in a different structure hash differently
+    this->update_hash(static_cast<uint8_t>(path.size()), nullptr, 0);
+}
+
+void WLMonitorParser::on_end(const JsonStreamPath& path, bool is_array) {
+    if (is_array) return;
+    if (path.matches({WL_PATH_DEPARTURE})) {
+        // Departures without a time are not shown, they would sort to the front as due
+        if (!this->is_line_rejected && this->has_departure_time) this->line.vehicles.push_back(this->vehicle);
+    } else if (path.matches({WL_PATH_LINE})) {
+        this->merge_line();
+        this->is_line_rejected = false;
+    } else if (path.matches({WL_PATH_TRAFFIC_INFO})) {
+        // Disruptions of lines that are not monitored are dropped right away
+        if (this->is_related(this->traffic_info)) {
+            this->traffic_infos.push_back(this->traffic_info);
+        }
+    }
+}
+
+void WLMonitorParser::on_value(const JsonStreamPath& path, JsonStreamValue type, const char* value, size_t length) {
+    const bool is_string = type == JSON_STREAM_STRING;
+    const bool is_true = type == JSON_STREAM_TRUE;
+    if (this->is_line_rejected) {
+        // Nothing else of a filtered line is built or hashed
+        return;
+    }
+    if (path.matches({WL_PATH_DEPARTURE, WL_KEY_DEPARTURE_TIME, path.back()})) {
+        switch (path.back()) {
+            case WL_KEY_COUNTDOWN:
+                if (type == JSON_STREAM_NUMBER) this->vehicle.countdown = atoi(value);
+                // The countdown follows the times, with a known time it only changes because time passes
+                if (this->vehicle.departure) return;
+                break;
+            case WL_KEY_TIME_REAL:
+                // The real time is preferred over the planned one
+                if (is_string) this->vehicle.departure = parse_timestamp(value);
+                break;
+            case WL_KEY_TIME_PLANNED:
+                if (is_string && !this->vehicle.departure) this->vehicle.departure = parse_timestamp(value);
+                break;
+            default:
+                return;
+        }
+    } else if (path.matches({WL_PATH_DEPARTURE, WL_KEY_VEHICLE, path.back()})) {
+        switch (path.back()) {
+            case WL_KEY_NAME:
+                if (is_string) this->vehicle.line = String(value);
+                break;
+            case WL_KEY_TOWARDS:
+                if (is_string) this->vehicle.towards = fix_json(String(value));
+                break;
+            case WL_KEY_BARRIER_FREE:
+                this->vehicle.is_barrier_free = is_true;
+                break;
+            case WL_KEY_FOLDING_RAMP:
+                this->vehicle.has_folding_ramp = is_true;
+                break;
+            default:
+                break;
+        }
+    } else if (path.matches({WL_PATH_LINE, path.back()})) {
+        switch (path.back()) {
+            case WL_KEY_NAME:
+                if (is_string) {
+                    this->line.line = String(value);
+                    // The name precedes the departures, so they are skipped for filtered lines
+                    this->is_line_rejected = !this->filter->matches_line(value);
+                }
+                break;
+            case WL_KEY_TOWARDS:
+                if (is_string) this->line.towards = fix_json(String(value));
+                break;
+            case WL_KEY_BARRIER_FREE:
+                this->line.is_barrier_free = is_true;
+                break;
+            default:
+                break;
+        }
+    } else if (path.matches({WL_PATH_MONITOR, WL_KEY_LOCATION_STOP, WL_KEY_PROPERTIES, WL_KEY_TITLE})) {
+        if (is_string) this->stop_name = Screen::ConvertGermanToLatin(String(value));
+    } else if (path.matches({WL_PATH_TRAFFIC_INFO, WL_KEY_TITLE})) {
+        if (is_string) this->traffic_info.title = Screen::ConvertGermanToLatin(String(value));
+    } else if (path.matches({WL_PATH_TRAFFIC_INFO, WL_KEY_DESCRIPTION})) {
+        if (is_string) this->traffic_info.description = Screen::ConvertGermanToLatin(String(value));
+    } else if (path.matches({WL_PATH_TRAFFIC_INFO, WL_KEY_RELATED_LINES, JSON_KEY_ITEM})) {
+        if (is_string) this->traffic_info.related_lines.push_back(String(value));
+    } else {
+        // Values that are not displayed (e.g. the server time) must not change the hash
+        return;
+    }
+    this->update_hash(path.back(), value, length);
+}
+
+void WLMonitorParser::update_hash(uint8_t key, const char* data, size_t length) {
+    // FNV-1a
+    this->content_hash = (this->content_hash ^ key) * 16777619u;
+    for (size_t i = 0; i < length; i++) {
+        this->content_hash = (this->content_hash ^ static_cast<uint8_t>(data[i])) * 16777619u;
+    }
+}
+
+uint32_t WLMonitorParser::get_content_hash() const {
+    return this->content_hash;
+}
+
+void WLMonitorParser::on_document_end() {
+    if (this->monitor_count) {
+        Serial.printf("Received %d monitor from WinerLinien API\n", this->monitor_count);
+    }
+    if (this->traffic_infos.size()) {
+        Serial.printf("Received %d traffic infos from WinerLinien API\n", this->traffic_infos.size());
+    }
+}
+
+void WLMonitorParser::merge_line() {
+    if (this->is_line_rejected || !this->filter->matches(this->line.line.c_str(), this->line.towards.c_str())) {
+        return;
+    }
+    this->line.stop = this->stop_name;
+    for (auto& vehicle : this->line.vehicles) {
+        if (vehicle.line.length() == 0) {
+            // take information in upper lavel
+            vehicle.line = this->line.line;
+            vehicle.towards = this->line.towards;
+            vehicle.is_barrier_free = this->line.is_barrier_free;
+            vehicle.has_folding_ramp = false;
+        }
+    }
+    merge_monitor(this->monitor_index, std::move(this->line));
+}
+
+void WLMonitorParser::set_related_lines(const std::vector<String>& lines) {
+    this->related_lines = lines;
+    for (const auto& line : lines) {
+        this->update_hash(JSON_KEY_UNKNOWN, line.c_str(), line.length());
+    }
+}
+
+bool WLMonitorParser::is_related(const TrafficInfo& info) const {
+    if (this->related_lines.empty()) {
+        return true;
+    }
+    for (const auto& line : this->related_lines) {
+        if (info.hasRelatedLine(line)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::vector<TrafficInfo>& WLMonitorParser::get_traffic_infos() {
+    return this->traffic_infos;
+}
+
 void WLDeparture::task_update(void * pvParameters) {
     WLDeparture* instance = (WLDeparture*)pvParameters;
     NetworkManager& network = NetworkManager::getInstance();
     Configuration& config = Configuration::getInstance();
-    JsonDocument filter;
-    // To filter the huge json WL is providing
-    if(filter["data"].isNull()){
-        JsonObject filter_data = filter["data"].to<JsonObject>();
-
-        JsonObject filter_monitors = filter_data["monitors"].add<JsonObject>();
-        filter_monitors["locationStop"]["properties"]["title"] = true;
-
-        JsonObject filter_lines = filter_monitors["lines"].add<JsonObject>();
-        filter_lines["name"] = true;
-        filter_lines["towards"] = true;
-        filter_lines["barrierFree"] = true;
-        filter_lines["foldingRamp"] = true;
-        filter_lines["trafficjam"] = true;
-
-        JsonObject filter_departure = filter_lines["departures"]["departure"].add<JsonObject>();
-        filter_departure["departureTime"]["countdown"] = true;
-
-        JsonObject filter_vehicle = filter_departure["vehicle"].to<JsonObject>();
-        filter_vehicle["name"] = true;
-        filter_vehicle["towards"] = true;
-        filter_vehicle["barrierFree"] = true;
-        filter_vehicle["foldingRamp"] = true;
-        filter_vehicle["trafficjam"] = true;
-
-        JsonObject filter_trafficInfos = filter_data["trafficInfos"].add<JsonObject>();
-        filter_trafficInfos["title"] = true;
-        filter_trafficInfos["description"] = true;
-        filter_trafficInfos["relatedLines"] = true;
-    }    
-    char url[140] = URL_WIENER_LINIEN; // 11 RBLs reserved
-    const int pos = strlen(url);
-    // To switch away from stream parsing if it fails, currently disabled
-    bool use_stream_parsing = false;
     while(true) {
         // 1. SLEEP: Wait indefinitely for the Timer to notify this task
         ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        instance->scheduler.begin_poll();
         if(network.acquire() == pdTRUE) {
-            HTTPClient https;
+            const String& rbl = config.get_rbl();
             if (WiFi.status() != WL_CONNECTED) {
+                // Not a server error, the radio is off in the eco mode and request_poll() follows its return
                 Serial.println(F("Couldn't fetch data - WiFi not connected."));
-                network.release();
-                continue;
-            }
-            const String& rbl = config.get_rbl();
-            int rbl_length = rbl.length();
-            if(!rbl_length){
+            } else if(!rbl.length()){
                 Serial.println(F("Couldn't fetch data - no RBL specified."));
-                network.release();
-                continue;
-            }
-            for(int i = pos; i<pos+rbl_length; i++){
-                url[i] = rbl[i-pos];
-            }
-            url[pos+rbl_length] = '\0';
-            Serial.printf("Fetching: %s\n", url);
-
-            // Start the HTTP request, reuse the SSL connection to avaoid failure because of heap fragmentation
-            https.begin(instance->secure_client, url);
-            int http_code = https.GET();
-
-            // Check if the request was successful
-            if (http_code == HTTP_CODE_OK) {
-                JsonDocument root;
-                // Stream parsing does not always work :/ (very large JSON this fails)
-                DeserializationError error;
-                if(use_stream_parsing){
-                    error = deserializeJson(
-                        root,
-                        https.getStream(),
-                        DeserializationOption::Filter(filter),
-                        DeserializationOption::NestingLimit(16)
-                    );
-                } else {
-                    error = deserializeJson(
-                        root,
-                        https.getString(),
-                        DeserializationOption::Filter(filter),
-                        DeserializationOption::NestingLimit(16)
-                    );
-                }
-                if (error) {
-                    Serial.printf("JSON parsing error: %S\n", error.c_str());
-                    switch (error.code())
-                    {
-                        case DeserializationError::Code::InvalidInput:
-                            // The first time Stream parsing fails, switch to String
-                            use_stream_parsing = false;
-                            break;
-                        case DeserializationError::Code::NoMemory:
-                            // Not enough memory to parse - restarting
-                            Serial.println(F("Not enough memory to deserialise the json from WienerLinien API"));
-                            delay(ERROR_RESET_DELAY);
-                            ESP.restart();
-                            break;
-                        
-                        default:
-                            break;
-                    }
-                } else if (xSemaphoreTake(instance->internal_mutex, portMAX_DELAY) == pdTRUE) {
-                    instance->monitors.clear();
-                    instance->fill_monitors_from_json(root);
-                    xSemaphoreGive(instance->internal_mutex);
-                    // Notify data coordinator of data update
-                    if(instance->notification != nullptr){
-                        xTaskNotifyGive(instance->notification);
-                    } else {
-                        Serial.println(F("Data update notification skipped."));
-                    }
-                    Serial.printf("Merged into %ld monitors.\n", instance->monitors.size());
-                }
             } else {
-                Serial.printf("HTTP Code: %d\n", http_code);
-                // Currently the software causes a lot of heap fragmentation
-                // This causes the SSL connection to fail, because it needs a lot of continuous RAM 
-                // To fix this the original software defined a reboot interval
-                // If SSL fails, the connection will be refused
-                if (http_code == HTTPC_ERROR_CONNECTION_REFUSED){
-                    // We restart to reset the heap
-                    ESP.restart();
-                }
+                instance->poll(rbl);
             }
-            https.end();
             network.release();
         }
+        instance->schedule_next_poll();
     }
 }
 
-void WLDeparture::callback_timer_update(TimerHandle_t xTimer) {
-    // 3. Retrieve the 'this' pointer from the Timer ID
-    WLDeparture* instance = (WLDeparture*)pvTimerGetTimerID(xTimer);
-    if (instance != nullptr && instance->handle_task_update != nullptr) {
-        xTaskNotifyGive(instance->handle_task_update);
+void WLDeparture::poll(const String& rbl) {
+    this->build_shards(rbl);
+    bool is_published = false;
+    // All shards are fetched back-to-back on the same connection
+    for (size_t i = 0; i < this->shard_urls.size(); i++) {
+        if (this->fetch_shard(i)) {
+            // Publish after every shard, so the first stops are shown before the last is received
+            this->publish_shards();
+            is_published = true;
+        }
+    }
+    // Disruptions change rarely, they are fetched on their own schedule after the lines are known
+    if (this->is_traffic_info_due() && this->fetch_traffic_infos()) {
+        this->publish_shards();
+        is_published = true;
+    }
+    if (!is_published && this->is_empty()) {
+        // An empty result is published with every poll, the data coordinator counts them to clear the screen
+        this->publish_shards();
     }
 }
 
-void WLDeparture::fill_monitors_from_json(JsonDocument& root) {
-    if (root["data"].isNull()) return;
-    Configuration& config = Configuration::getInstance();
-    const JsonObject data = root["data"];
-    std::vector<TrafficInfo> traffic_infos;
-    const JsonArray json_traffic_infos = data["trafficInfos"];
-    if (!json_traffic_infos.isNull()) {
-        for (const auto& json_traffic_info : json_traffic_infos) {
-            struct TrafficInfo traffic_info;
-            const JsonVariant json_title = json_traffic_info["title"];
-            if (!json_title.isNull()) {
-                traffic_info.title = Screen::ConvertGermanToLatin(json_title.as<String>());
+bool WLDeparture::is_empty() const {
+    for (const auto& shard : this->shard_monitors) {
+        if (!shard.empty()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void WLDeparture::schedule_next_poll() {
+    SourceSnapshot latest;
+    this->get_latest_snapshot(latest);
+    uint32_t delay = this->scheduler.next_delay(*latest.monitors);
+    // Changing the period of the one-shot timer also starts it
+    xTimerChangePeriod(this->handle_timer_update, pdMS_TO_TICKS(delay), portMAX_DELAY);
+}
+
+void WLDeparture::request_poll() {
+    if (this->handle_timer_update != nullptr) {
+        // Changing the period restarts the one-shot timer, the scheduled poll is replaced
+        xTimerChangePeriod(this->handle_timer_update, pdMS_TO_TICKS(POLL_DELAY_WAKE), portMAX_DELAY);
+    }
+}
+
+void WLDeparture::build_shards(const String& rbl) {
+    if (rbl != this->shard_rbl) {
+        // Different stops are configured, the old results are not valid anymore
+        this->shard_rbl = rbl;
+        this->shard_urls.clear();
+        this->shard_monitors.clear();
+        this->shard_hashes.clear();
+        String url = URL_WIENER_LINIEN;
+        const size_t base_length = url.length();
+        for_each_entry(rbl, [&](const String& id) {
+            if (url.length() > base_length && url.length() + 1 + id.length() > WL_MAX_URL_LENGTH) {
+                this->shard_urls.push_back(url);
+                url = URL_WIENER_LINIEN;
             }
-            const JsonVariant json_description = json_traffic_info["description"];
-            if (!json_description.isNull()) {
-                traffic_info.description = Screen::ConvertGermanToLatin(json_description.as<String>());
+            if (url.length() > base_length) {
+                url += ',';
             }
-            const JsonArray related_lines = json_traffic_info["relatedLines"];
-            for (const auto& related_line : related_lines) {
-                traffic_info.related_lines.push_back(related_line.as<String>());
+            url += id;
+        });
+        if (url.length() > base_length) {
+            this->shard_urls.push_back(url);
+        }
+        this->shard_monitors.resize(this->shard_urls.size());
+        this->shard_hashes.resize(this->shard_urls.size(), 0);
+        // Other lines might be monitored now
+        this->traffic_info_updated = 0;
+        Serial.printf("Split RBLs into %d requests.\n", this->shard_urls.size());
+    }
+}
+
+bool WLDeparture::fetch_shard(size_t idx) {
+    Configuration& config = Configuration::getInstance();
+    const String& url = this->shard_urls[idx];
+    bool is_updated = false;
+    Serial.printf("Fetching: %s\n", url.c_str());
+
+    // Start the HTTP request, reuse the SSL connection to avaoid failure because of heap fragmentation
+    int http_code = this->send_request(url);
+    bool keep_connection = false;
+
+    // Check if the request was successful
+    if (http_code == HTTP_CODE_OK) {
+        // The response is parsed while it is received, neither the body nor a JsonDocument is kept in memory
+        this->line_filter.compile(config.get_rbl_filter());
+        this->monitor_parser.begin(this->line_filter);
+        this->stream_parser.reset(&this->monitor_parser);
+        int result = this->https.writeToStream(&this->stream_parser);
+        if (result < 0 || !this->stream_parser.is_done()) {
+            Serial.printf(
+                "JSON parsing error after %d bytes (HTTP result %d)\n",
+                this->stream_parser.get_bytes_fed(), result
+            );
+            this->scheduler.report_error();
+        } else {
+            // Same departures as in the last poll leave nothing to merge
+            if (this->is_content_changed(this->shard_hashes[idx], this->monitor_parser.get_content_hash())) {
+                this->shard_monitors[idx].swap(this->pending_monitors);
+                is_updated = true;
             }
-            traffic_infos.push_back(traffic_info);
+            // Only a completely consumed response leaves the connection in a reusable state
+            keep_connection = true;
         }
+    } else {
+        Serial.printf("HTTP Code: %d\n", http_code);
+        this->scheduler.report_error();
+        this->restart_if_refused(http_code);
+    }
+    this->https.end();
+    if (!keep_connection) {
+        this->secure_client.stop();
     }
+    return is_updated;
+}
 
-    const JsonArray json_monitors = data["monitors"];
-    Serial.printf("Received %d monitor from WinerLinien API\n", json_monitors.size());
-    if (!json_monitors.isNull()) {
-        String rbl_filter = config.get_rbl_filter();
-        std::vector<String> filters;
-        if(rbl_filter.length()){
-            int pos = 0, end = rbl_filter.indexOf(",", pos);
-            if(end == -1){
-                filters.push_back(rbl_filter);
-            } else {
-                do {
-                    filters.push_back(rbl_filter.substring(pos, end));
-                    pos = end+1;
-                    end = rbl_filter.indexOf(",", pos);
-                } while(end != -1);
-                //Add the last elment
-                filters.push_back(rbl_filter.substring(pos));
+bool WLDeparture::is_traffic_info_due() {
+    return this->traffic_info_updated == 0 || millis() - this->traffic_info_updated >= TRAFFIC_INFO_UPDATE_DELAY;
+}
+
+bool WLDeparture::fetch_traffic_infos() {
+    std::vector<String> lines;
+    for (const auto& shard : this->shard_monitors) {
+        for (const auto& monitor : shard) {
+            if (std::find(lines.begin(), lines.end(), monitor.line) == lines.end()) {
+                lines.push_back(monitor.line);
             }
         }
-        for (const auto& json_monitor : json_monitors) {
-            const JsonArray json_lines = json_monitor["lines"];
-            const JsonObject json_stop = json_monitor["locationStop"]["properties"];
-            String stop_name = Screen::ConvertGermanToLatin(json_stop["title"].as<String>());
-            for (const auto& json_line : json_lines) {
-                String line_name = json_line["name"].as<String>();
-                bool filter_match = filters.empty();
-                for(String filter : filters){
-                    if(filter == line_name) {
-                        filter_match = true;
-                        break;
-                    }
-                }
-                if(!filter_match){
-                    continue;
-                }
-                String line_towards = fix_json(json_line["towards"].as<String>());
-                bool line_barrierfree = json_line["barrierFree"].as<bool>();
-                Monitor* monitor_p = findMonitor(this->monitors, line_name, stop_name);
-                Monitor monitor;
-                monitor.line = line_name;
-                monitor.stop = stop_name;
-                monitor.towards = line_towards;
-                monitor.is_barrier_free = line_barrierfree;
-                for (const auto& info : traffic_infos) {
-                    if (info.hasRelatedLine(line_name)) {
-                        if (monitor_p) {
-                            monitor_p->traffic_info = info;
-                        } else {
-                            monitor.traffic_info = info;
-                        }
-                        break;
-                    }
-                }
-                
-                const JsonVariant json_departure = json_line["departures"]["departure"];
-                if (json_departure.is<JsonArray>()) {
-                    for (const auto& departure : json_departure.as<JsonArray>()) {
-                        int countdown = -1;
-                        const JsonObject departureTime = departure["departureTime"];
-                        if (!departureTime.isNull()) {
-                            Vehicle vehicle;
-                            vehicle.is_cancelled = false;
-                            vehicle.is_airport = false;
-                            vehicle.countdown = departureTime["countdown"].as<int>();
-                            const JsonObject json_vehicle = departure["vehicle"];
-                            if (!json_vehicle.isNull()) {
-                                vehicle.line = json_vehicle["name"].as<String>();
-                                vehicle.towards = fix_json(json_vehicle["towards"].as<String>());
-                                vehicle.is_barrier_free = json_vehicle["barrierFree"].as<bool>();
-                                vehicle.has_folding_ramp = json_vehicle["foldingRamp"].as<bool>();
-                            } else {
-                                // take information in upper lavel
-                                vehicle.line = monitor.line;
-                                vehicle.towards = monitor.towards;
-                                vehicle.is_barrier_free = monitor.is_barrier_free;
-                                vehicle.has_folding_ramp = false;
-                            }
-                            if (monitor_p) {
-                                //Monitor with line name already exists -> different towards
-                                monitor_p->vehicles.push_back(vehicle);
-                            } else {
-                                monitor.vehicles.push_back(vehicle);
-                            }
-                        }
-                    }
-                    if (monitor_p) {
-                        // sort vehicles by arriving time
-                        std::sort(
-                            monitor_p->vehicles.begin(), monitor_p->vehicles.end(),
-                            [](const Vehicle& a, const Vehicle& b) {
-                                return a.countdown < b.countdown;
-                            }
-                        );
-                    }
-                }
-                if (!monitor_p) {
-                    // New monitor with linename and stop
-                    this->monitors.push_back(monitor);
-                }
+    }
+    if (lines.empty()) {
+        // Wait until the departures tell which lines are relevant
+        return false;
+    }
+    bool is_updated = false;
+    Serial.printf("Fetching: %s\n", URL_WIENER_LINIEN_TRAFFIC_INFO);
+    int http_code = this->send_request(URL_WIENER_LINIEN_TRAFFIC_INFO);
+    bool keep_connection = false;
+    if (http_code == HTTP_CODE_OK) {
+        this->monitor_parser.begin(this->line_filter);
+        this->monitor_parser.set_related_lines(lines);
+        this->stream_parser.reset(&this->monitor_parser);
+        int result = this->https.writeToStream(&this->stream_parser);
+        if (result < 0 || !this->stream_parser.is_done()) {
+            Serial.printf(
+                "JSON parsing error after %d bytes (HTTP result %d)\n",
+                this->stream_parser.get_bytes_fed(), result
+            );
+        } else {
+            keep_connection = true;
+            this->traffic_info_updated = millis();
+            if (this->monitor_parser.get_content_hash() != this->traffic_info_hash) {
+                this->traffic_info_hash = this->monitor_parser.get_content_hash();
+                this->traffic_info_cache.swap(this->monitor_parser.get_traffic_infos());
+                this->traffic_info_index.build(this->traffic_info_cache);
+                is_updated = true;
             }
         }
+    } else {
+        Serial.printf("HTTP Code: %d\n", http_code);
+    }
+    this->https.end();
+    if (!keep_connection) {
+        this->secure_client.stop();
+    }
+    return is_updated;
+}
+
+void WLDeparture::publish_shards() {
+    // The shards are only touched by this task, the new snapshot is built without the lock
+    std::shared_ptr<std::vector<Monitor>> monitors = this->acquire_buffer();
+    this->publish_index.attach(*monitors);
+    for (const auto& shard : this->shard_monitors) {
+        for (const auto& monitor : shard) {
+            // The same line and stop can be split across shards
+            merge_monitor(this->publish_index, monitor);
+        }
+    }
+    // Join the cached disruptions by line
+    for (auto& monitor : *monitors) {
+        const TrafficInfo* info = this->traffic_info_index.find(monitor.line);
+        if (info) {
+            monitor.traffic_info = *info;
+        }
+    }
+    this->publish(monitors);
+}
+
+bool WLDeparture::connect() {
+    if (this->secure_client.connected()) {
+        this->connection_stats.reused_connections++;
+        return true;
+    }
+    // Establish the connection here instead of in HTTPClient to measure the handshake
+    unsigned long start = millis();
+    bool is_connected = this->secure_client.connect(HOST_WIENER_LINIEN, 443);
+    unsigned long duration = millis() - start;
+    if (!is_connected) {
+        this->connection_stats.failed_handshakes++;
+        Serial.printf("TLS handshake with %s failed after %lu ms.\n", HOST_WIENER_LINIEN, duration);
+        return false;
+    }
+    this->connection_stats.handshakes++;
+    this->connection_stats.last_handshake_ms = duration;
+    this->connection_stats.total_handshake_ms += duration;
+    if (duration > this->connection_stats.max_handshake_ms) {
+        this->connection_stats.max_handshake_ms = duration;
+    }
+    Serial.printf(
+        "TLS handshake took %lu ms (%d handshakes, avg %lu ms, %d reused polls).\n",
+        duration, this->connection_stats.handshakes,
+        this->connection_stats.total_handshake_ms / this->connection_stats.handshakes,
+        this->connection_stats.reused_connections
+    );
+    return true;
+}
+
+int WLDeparture::send_request(const String& url) {
+    const bool is_reused = this->secure_client.connected();
+    if (!this->connect()) {
+        // If SSL fails, the connection will be refused - we restart to reset the heap
+        ESP.restart();
+    }
+    this->https.begin(this->secure_client, url);
+    int http_code = this->https.GET();
+    if (http_code < 0 && is_reused) {
+        // The server closed the idle connection since the last poll, which only shows when it is used
+        this->https.end();
+        this->secure_client.stop();
+        this->connection_stats.stale_retries++;
+        Serial.printf("Reused connection failed (%d), retrying with a new handshake (%d retries).\n", http_code, this->connection_stats.stale_retries);
+        if (!this->connect()) {
+            ESP.restart();
+        }
+        this->https.begin(this->secure_client, url);
+        http_code = this->https.GET();
     }
+    return http_code;
 }
 
-WLDeparture::WLDeparture() : internal_mutex(nullptr), handle_timer_update(nullptr), handle_task_update(nullptr), notification(nullptr){
-    this->internal_mutex = xSemaphoreCreateMutex();
+void WLDeparture::callback_timer_update(TimerHandle_t xTimer) {
+    // 3. Retrieve the 'this' pointer from the Timer ID
+    WLDeparture* instance = (WLDeparture*)pvTimerGetTimerID(xTimer);
+    if (instance != nullptr && instance->handle_task_update != nullptr) {
+        xTaskNotifyGive(instance->handle_task_update);
+    }
+}
+
+WLDeparture::WLDeparture() : DepartureSource("WL"), handle_timer_update(nullptr), handle_task_update(nullptr), traffic_info_hash(0), traffic_info_updated(0), monitor_parser(pending_monitors), scheduler("WL"){
     this->secure_client = WiFiClientSecure();
     this->secure_client.setInsecure();
+    // Keep the connection open between polls, the server closes it when idle for too long
+    this->https.setReuse(true);
 }
 
 void WLDeparture::setup(){
@@ -304,10 +545,11 @@ void WLDeparture::setup(){
     if(status != pdTRUE){
         Serial.printf("Could not create update task for WienerLinien: %d\n", status);
     }
+    // One-shot timer, the task schedules the next poll after each update
     this->handle_timer_update = xTimerCreate(
         "timer_update_wl",
         pdMS_TO_TICKS(DATA_UPDATE_DELAY),
-        pdTRUE,
+        pdFALSE,
         (void*)this,
         &callback_timer_update
     );
@@ -315,19 +557,10 @@ void WLDeparture::setup(){
     if (this->handle_timer_update != NULL) {
         // Run the update function immediately once
         callback_timer_update(this->handle_timer_update);
-        xTimerStart(this->handle_timer_update, 0);
     }    
 }
 
-void WLDeparture::set_notification(TaskHandle_t task){
-    this->notification = task;
+ConnectionStats WLDeparture::get_connection_stats(){
+    return this->connection_stats;
 }
 
-void WLDeparture::get_latest_snapshot(std::vector<Monitor>& data){
-    data.clear();
-    // Lock briefly just to copy the internal vector
-    if (xSemaphoreTake(this->internal_mutex, portMAX_DELAY) == pdTRUE) {
-        data.insert(data.end(), this->monitors.begin(), this->monitors.end());
-        xSemaphoreGive(this->internal_mutex);
-    }
-}
@@ -0,0 +1,144 @@
+/**
+ * Host benchmark and check of parse_timestamp(), it needs no Arduino core:
+ *
+ *   g++ -O2 -std=gnu++11 -Iinclude test/bench_timestamp/bench_timestamp.cpp src/timestamp.cpp -o bench_timestamp
+ *   ./bench_timestamp
+ *
+ * Every result is compared with gmtime() over a range of epochs and offset
+ * formats, then the parser is timed against the sscanf and TZ-swapping
+ * mktime conversion it replaced and against strptime. Exits with 1 if a
+ * result differs.
+ */
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "timestamp.h"
+
+#define BENCH_SAMPLES (2000)
+#define BENCH_ROUNDS (50)
+
+struct Sample {
+    std::string text;
+    time_t epoch;
+};
+
+// The conversion before parse_timestamp(), only "YYYY-MM-DDTHH:MM:SSZ" is accepted
+static time_t parse_sscanf_mktime(const char* s) {
+    struct tm t = {0};
+    if (sscanf(s, "%d-%d-%dT%d:%d:%dZ", &t.tm_year, &t.tm_mon, &t.tm_mday, &t.tm_hour, &t.tm_min, &t.tm_sec) != 6) {
+        return 0;
+    }
+    t.tm_year -= 1900;
+    t.tm_mon -= 1;
+    t.tm_isdst = 0;
+    char* tz = getenv("TZ");
+    if (tz) {
+        tz = strdup(tz);
+    }
+    setenv("TZ", "", 1);
+    tzset();
+    time_t result = mktime(&t);
+    if (tz) {
+        setenv("TZ", tz, 1);
+        free(tz);
+    } else {
+        unsetenv("TZ");
+    }
+    tzset();
+    return result;
+}
+
+static time_t parse_strptime(const char* s) {
+    struct tm t = {0};
+    if (strptime(s, "%Y-%m-%dT%H:%M:%SZ", &t) == nullptr) {
+        return 0;
+    }
+    return timegm(&t);
+}
+
+// Formats the epoch as seen from a timezone offset in minutes
+static std::string format(time_t epoch, int offset, int style) {
+    time_t local = epoch + offset * 60;
+    struct tm t;
+    gmtime_r(&local, &t);
+    char text[40];
+    size_t length = strftime(text, sizeof(text), "%Y-%m-%dT%H:%M:%S", &t);
+    const char sign = offset < 0 ? '-' : '+';
+    const int minutes = offset < 0 ? -offset : offset;
+    switch (style) {
+        case 0:
+            snprintf(text + length, sizeof(text) - length, "Z");
+            break;
+        case 1:
+            snprintf(text + length, sizeof(text) - length, ".%03d%c%02d%02d", static_cast<int>(epoch % 1000), sign, minutes / 60, minutes % 60);
+            break;
+        case 2:
+            snprintf(text + length, sizeof(text) - length, "%c%02d:%02d", sign, minutes / 60, minutes % 60);
+            break;
+        default:
+            break;
+    }
+    return text;
+}
+
+static int check(const std::vector<Sample>& samples) {
+    int failures = 0;
+    for (const auto& sample : samples) {
+        const time_t result = parse_timestamp(sample.text.c_str());
+        if (result != sample.epoch) {
+            printf("FAIL %s: %lld, expected %lld\n", sample.text.c_str(), static_cast<long long>(result), static_cast<long long>(sample.epoch));
+            failures++;
+        }
+    }
+    const char* invalid[] = {"", "garbage", "2024-13-01T00:00:00Z", "2024-05-01 08:00", "2024-05-01T08:00:30X", "2024-05-01T08:00:30+2"};
+    for (const char* text : invalid) {
+        if (parse_timestamp(text) != 0) {
+            printf("FAIL \"%s\" was accepted\n", text);
+            failures++;
+        }
+    }
+    return failures;
+}
+
+template<typename Parser>
+static void bench(const char* name, const std::vector<Sample>& samples, Parser parser) {
+    long long sum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        for (const auto& sample : samples) {
+            sum += parser(sample.text.c_str());
+        }
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+    printf("%-16s %8.1f ns per timestamp (checksum %lld)\n", name, static_cast<double>(elapsed.count()) / (BENCH_ROUNDS * samples.size()), sum);
+}
+
+int main() {
+    // The conversions must not depend on the local timezone
+    setenv("TZ", "CET-1CEST,M3.5.0,M10.5.0/3", 1);
+    tzset();
+
+    std::vector<Sample> samples;
+    std::vector<Sample> utc_samples;
+    srand(1);
+    for (int i = 0; i < BENCH_SAMPLES; i++) {
+        // 1970 to 2100, plus the edges of the range
+        time_t epoch = i == 0 ? 0 : (i == 1 ? 4102444799 : static_cast<time_t>((static_cast<long long>(rand()) * 4102444799LL) / RAND_MAX));
+        const int offset = (rand() % 49 - 24) * 30;
+        const int style = i % 3;
+        samples.push_back(Sample{format(epoch, style == 0 ? 0 : offset, style), epoch});
+        utc_samples.push_back(Sample{format(epoch, 0, 0), epoch});
+    }
+
+    const int failures = check(samples) + check(utc_samples);
+    printf("%d timestamps checked against gmtime, %d failures\n", 2 * BENCH_SAMPLES, failures);
+
+    bench("parse_timestamp", utc_samples, parse_timestamp);
+    bench("sscanf + mktime", utc_samples, parse_sscanf_mktime);
+    bench("strptime", utc_samples, parse_strptime);
+    return failures ? 1 : 0;
+}